@@ -0,0 +1,109 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "bankaccount.hpp"
+using namespace std;
+
+// A large batch of deposits/withdrawals over accounts kept in one vector,
+// stored as a structure of arrays (one array per field) instead of a vector of
+// BankAccountCommand objects.
+//
+// call() does not go through virtual calls and a switch per command. It
+// works out each command's signed delta in one loop the compiler can
+// vectorize, then makes one pass in the original order, deciding each
+// withdrawal without a branch straight on the account. Only the accounts the
+// batch names are read or written, however many `accounts` holds. Copying
+// the balances into a dense array first and back afterwards was tried: over
+// the whole vector it made a small batch cost O(accounts), over just the
+// touched accounts the bookkeeping cost more than the smaller working set
+// saved. So was sorting the commands by account: the scatter into 1024 runs
+// and back cost more than it saved.
+//
+// The balances are written directly, so unlike BankAccountCommand the batch
+// does not publish a BankEvent per command.
+class BatchBankAccountCommand
+{
+    vector<BankAccount>& accounts;
+
+    // scratch space reused by call(), kept for undo()
+    vector<int> signed_amount;   // +amount for deposits, -amount for withdrawals
+
+public:
+    // one entry per command, in the order they were added
+    vector<uint32_t> account;
+    vector<uint8_t> action;      // BankAccountCommand::Action
+    vector<int> amount;
+    vector<uint8_t> succeeded;
+
+    explicit BatchBankAccountCommand(vector<BankAccount>& accounts)
+        : accounts(accounts)
+    {}
+
+    void reserve(size_t n)
+    {
+        account.reserve(n);
+        action.reserve(n);
+        amount.reserve(n);
+        succeeded.reserve(n);
+    }
+
+    // false, and nothing added, if `account_index` isn't in `accounts`
+    bool add(size_t account_index, BankAccountCommand::Action a, int amt)
+    {
+        if (account_index >= accounts.size()) return false;
+        account.push_back(static_cast<uint32_t>(account_index));
+        action.push_back(static_cast<uint8_t>(a));
+        amount.push_back(amt);
+        succeeded.push_back(0);
+        return true;
+    }
+
+    // false if the command's account doesn't live in `accounts`
+    bool add(const BankAccountCommand& cmd)
+    {
+        // std::less orders any two pointers, `<` only those into one array
+        less<const BankAccount*> before;
+        const BankAccount* first = accounts.data();
+        if (before(&cmd.account, first) || !before(&cmd.account, first + accounts.size())) return false;
+        return add(static_cast<size_t>(&cmd.account - first), cmd.action, cmd.amount);
+    }
+
+    size_t size() const { return account.size(); }
+
+    void call()
+    {
+        const size_t n = size();
+
+        // branch free so it vectorizes: deposit = +amount, withdraw = -amount
+        signed_amount.resize(n);
+        for (size_t i = 0; i < n; ++i)
+            signed_amount[i] = amount[i] * (1 - 2 * int(action[i]));
+
+        // a failed withdraw changes nothing
+        for (size_t i = 0; i < n; ++i)
+        {
+            auto& ba = accounts[account[i]];
+            int delta = signed_amount[i];
+            bool ok = (delta >= 0) | (ba.balance + delta >= ba.overdraft_limit);
+            ba.balance += ok ? delta : 0;
+            succeeded[i] = ok;
+        }
+    }
+
+    // Reverses every command that succeeded, last first, the way the
+    // composite's undo() does: taking back a deposit is a withdrawal, so it
+    // is skipped if the account can't afford it any more (something else
+    // took the money in between), just like BankAccount::withdraw.
+    void undo()
+    {
+        for (size_t i = size(); i-- > 0;)
+        {
+            auto& ba = accounts[account[i]];
+            int delta = succeeded[i] ? -signed_amount[i] : 0;
+            bool ok = (delta >= 0) | (ba.balance + delta >= ba.overdraft_limit);
+            ba.balance += ok ? delta : 0;
+        }
+    }
+};
@@ -0,0 +1,132 @@
+#include <iostream>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "bankaccount.hpp"
+#include "compactcommand.hpp"
+#include "batchcommand.hpp"
+using namespace std;
+
+// Same random mix of deposits, withdrawals and transfers, built/called/undone
+// once as heap allocated virtual Commands and once as a CommandBuffer.
+// Then deposits/withdrawals only, as a CompositeBankAccountCommand and as a
+// columnar BatchBankAccountCommand.
+// usage: ./commandbench [commands] [accounts]
+
+struct Op
+{
+    int kind;       // 0 deposit, 1 withdraw, 2 transfer
+    size_t from, to;
+    int amount;
+};
+
+template <typename F>
+double ns_per(size_t n, F&& f)
+{
+    auto start = chrono::steady_clock::now();
+    f();
+    chrono::duration<double, nano> took = chrono::steady_clock::now() - start;
+    return took.count() / n;
+}
+
+int main(int argc, char* argv[])
+{
+    const size_t n = argc > 1 ? stoul(argv[1]) : 2'000'000;
+    const size_t accounts = argc > 2 ? stoul(argv[2]) : 1024;
+
+    NullSink quiet;
+    vector<BankAccount> bank(accounts);
+    for (auto& ba : bank) ba.events = &quiet;
+
+    mt19937 rng{ 7 };
+    uniform_int_distribution<int> kind{ 0, 2 }, amount{ 1, 100 };
+    uniform_int_distribution<size_t> pick{ 0, accounts - 1 };
+    vector<Op> ops(n);
+    for (auto& op : ops) op = { kind(rng), pick(rng), pick(rng), amount(rng) };
+
+    // virtual hierarchy
+    vector<unique_ptr<Command>> hierarchy;
+    double v_build = ns_per(n, [&] {
+        hierarchy.reserve(n);
+        for (auto& op : ops)
+        {
+            auto& a = bank[op.from];
+            if (op.kind == 0)
+                hierarchy.push_back(make_unique<BankAccountCommand>(a, BankAccountCommand::deposit, op.amount));
+            else if (op.kind == 1)
+                hierarchy.push_back(make_unique<BankAccountCommand>(a, BankAccountCommand::withdraw, op.amount));
+            else
+                hierarchy.push_back(make_unique<MoneyTransferCommand>(a, bank[op.to], op.amount));
+        }
+    });
+    double v_call = ns_per(n, [&] { for (auto& c : hierarchy) c->call(); });
+    double v_undo = ns_per(n, [&] {
+        for (auto it = hierarchy.rbegin(); it != hierarchy.rend(); ++it) (*it)->undo();
+    });
+    long v_check = 0;
+    for (auto& ba : bank) v_check += ba.balance;
+
+    // compact commands
+    CommandBuffer buffer;
+    double c_build = ns_per(n, [&] {
+        buffer.reserve(n);
+        for (auto& op : ops)
+        {
+            auto* a = &bank[op.from];
+            if (op.kind == 0)      buffer.add(compact::Deposit{ a, op.amount });
+            else if (op.kind == 1) buffer.add(compact::Withdraw{ a, op.amount });
+            else                   buffer.add(compact::Transfer{ a, &bank[op.to], op.amount });
+        }
+    });
+    double c_call = ns_per(n, [&] { buffer.call(); });
+    double c_undo = ns_per(n, [&] { buffer.undo(); });
+    long c_check = 0;
+    for (auto& ba : bank) c_check += ba.balance;
+
+    cout << n << " commands over " << accounts << " accounts (ns/command)\n"
+         << "              build   call   undo\n"
+         << "virtual    " << v_build << "  " << v_call << "  " << v_undo << "\n"
+         << "compact    " << c_build << "  " << c_call << "  " << c_undo << "\n"
+         << "sizeof(CompactCommand) = " << sizeof(CompactCommand) << " bytes inline, "
+         << "sizeof(MoneyTransferCommand) = " << sizeof(MoneyTransferCommand)
+         << " + 2 * " << sizeof(BankAccountCommand) << " bytes on the heap\n"
+         << "balances after undo " << (v_check == 0 && c_check == 0 ? "back to 0" : "differ") << "\n\n";
+
+    // composite vs columnar batch, the same deposits and withdrawals
+    vector<BankAccount> bank2(accounts);
+    for (auto& ba : bank2) ba.events = &quiet;
+
+    CompositeBankAccountCommand composite{};
+    double s_build = ns_per(n, [&] {
+        composite.reserve(n);
+        for (auto& op : ops)
+            composite.push_back(BankAccountCommand{ bank[op.from],
+                op.kind == 0 ? BankAccountCommand::deposit : BankAccountCommand::withdraw, op.amount });
+    });
+    double s_call = ns_per(n, [&] { composite.call(); });
+
+    BatchBankAccountCommand batch{ bank2 };
+    double b_build = ns_per(n, [&] {
+        batch.reserve(n);
+        for (auto& op : ops)
+            batch.add(op.from, op.kind == 0 ? BankAccountCommand::deposit : BankAccountCommand::withdraw, op.amount);
+    });
+    double b_call = ns_per(n, [&] { batch.call(); });
+
+    bool same = true;
+    for (size_t a = 0; a < accounts; ++a) same &= bank[a].balance == bank2[a].balance;
+    for (size_t i = 0; i < n; ++i) same &= composite[i].succeeded == bool(batch.succeeded[i]);
+
+    double s_undo = ns_per(n, [&] { composite.undo(); });
+    double b_undo = ns_per(n, [&] { batch.undo(); });
+    for (size_t a = 0; a < accounts; ++a) same &= bank[a].balance == bank2[a].balance;
+
+    cout << "deposits/withdrawals only (ns/command)\n"
+         << "              build   call   undo\n"
+         << "composite  " << s_build << "  " << s_call << "  " << s_undo << "\n"
+         << "batch      " << b_build << "  " << b_call << "  " << b_undo << "\n"
+         << "batch results " << (same ? "match" : "DIFFER FROM") << " the composite\n";
+    return 0;
+}
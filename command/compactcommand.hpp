@@ -0,0 +1,110 @@
+#pragma once
+#include <variant>
+#include <vector>
+#include "bankaccount.hpp"
+using namespace std;
+
+// The same commands as BankAccountCommand/MoneyTransferCommand but as plain
+// structs with no base class. A CompactCommand is a std::variant of them, so
+// it has a fixed size (no heap allocation per command) and call()/undo()
+// dispatch through std::visit instead of a virtual call.
+namespace compact
+{
+    struct Deposit
+    {
+        BankAccount* account;
+        int amount;
+        bool succeeded = false;
+
+        void call()
+        {
+            account->deposit(amount);
+            succeeded = true;
+        }
+
+        void undo()
+        {
+            if (succeeded) account->withdraw(amount);
+        }
+    };
+
+    struct Withdraw
+    {
+        BankAccount* account;
+        int amount;
+        bool succeeded = false;
+
+        void call()
+        {
+            succeeded = account->withdraw(amount);
+        }
+
+        void undo()
+        {
+            if (succeeded) account->deposit(amount);
+        }
+    };
+
+    // behaves like MoneyTransferCommand: no deposit unless the withdraw
+    // went through, undo runs the legs in reverse
+    struct Transfer
+    {
+        BankAccount* from;
+        BankAccount* to;
+        int amount;
+        bool succeeded = false;
+
+        void call()
+        {
+            succeeded = from->withdraw(amount);
+            if (succeeded) to->deposit(amount);
+        }
+
+        void undo()
+        {
+            if (!succeeded) return;
+            to->withdraw(amount);
+            from->deposit(amount);
+        }
+    };
+}
+
+using CompactCommand = variant<compact::Deposit, compact::Withdraw, compact::Transfer>;
+
+inline void call(CompactCommand& cmd)
+{
+    visit([](auto& c) { c.call(); }, cmd);
+}
+
+inline void undo(CompactCommand& cmd)
+{
+    visit([](auto& c) { c.undo(); }, cmd);
+}
+
+inline bool succeeded(const CompactCommand& cmd)
+{
+    return visit([](auto& c) { return c.succeeded; }, cmd);
+}
+
+// Commands stored back to back in one vector, the composite of compact commands.
+// After reserve() adding, calling and undoing never allocate.
+struct CommandBuffer
+{
+    vector<CompactCommand> commands;
+
+    void reserve(size_t n) { commands.reserve(n); }
+
+    template <typename Cmd>
+    void add(Cmd cmd) { commands.emplace_back(cmd); }
+
+    void call()
+    {
+        for (auto& cmd : commands) ::call(cmd);
+    }
+
+    void undo()
+    {
+        for (auto it = commands.rbegin(); it != commands.rend(); ++it)
+            ::undo(*it);
+    }
+};
@@ -0,0 +1,185 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+using namespace std;
+
+struct BankAccount;
+
+// What happened to an account, published after every successful deposit/withdraw
+struct BankEvent
+{
+    const BankAccount* account;
+    enum Kind { deposited, withdrew } kind;
+    int amount;
+    int balance;
+
+    friend ostream& operator<<(ostream& os, const BankEvent& e)
+    {
+        return os << (e.kind == deposited ? "deposited " : "withdrew ")
+                  << e.amount << ", balance now " << e.balance << "\n";
+    }
+};
+
+struct BankEventSink
+{
+    virtual ~BankEventSink() = default;
+    virtual void publish(const BankEvent& e) = 0;
+};
+
+// the original behaviour, one line on cout per event
+struct ConsoleSink : BankEventSink
+{
+    void publish(const BankEvent& e) override
+    {
+        cout << e;
+    }
+};
+
+inline ConsoleSink& console_sink()
+{
+    static ConsoleSink sink;
+    return sink;
+}
+
+// drops everything, for when only the balances matter
+struct NullSink : BankEventSink
+{
+    void publish(const BankEvent&) override {}
+};
+
+// Collects events in memory and writes them out in one go, either when
+// `capacity` events are waiting or when flush() is called
+class BufferedSink : public BankEventSink
+{
+    ostream& out;
+    size_t capacity;
+    mutex m;
+    vector<BankEvent> events;
+
+public:
+    explicit BufferedSink(ostream& out, size_t capacity = 4096)
+        : out(out), capacity(capacity)
+    {
+        events.reserve(capacity);
+    }
+
+    ~BufferedSink() { flush(); }
+
+    void publish(const BankEvent& e) override
+    {
+        lock_guard<mutex> lock{ m };
+        events.push_back(e);
+        if (events.size() >= capacity)
+            write_out();
+    }
+
+    void flush()
+    {
+        lock_guard<mutex> lock{ m };
+        write_out();
+    }
+
+private:
+    void write_out()
+    {
+        for (auto& e : events) out << e;
+        events.clear();
+    }
+};
+
+// Bounded multi-producer ring buffer (Vyukov's sequence per slot algorithm),
+// publish() never takes a lock or touches the stream. A background thread
+// drains the ring into `out`. When the ring is full the event is dropped and
+// counted rather than making the account wait on I/O.
+class RingBufferSink : public BankEventSink
+{
+    struct Slot
+    {
+        atomic<size_t> seq;
+        BankEvent event;
+    };
+
+    size_t mask;
+    unique_ptr<Slot[]> slots;
+    alignas(64) atomic<size_t> head{ 0 };    // next slot producers claim
+    alignas(64) size_t tail = 0;             // only the drain thread reads it
+    atomic<size_t> lost{ 0 };
+    ostream& out;
+    jthread drainer;                         // last, so it stops before the ring goes
+
+public:
+    // capacity is rounded up to a power of 2
+    explicit RingBufferSink(ostream& out, size_t capacity = 1 << 16)
+        : out(out)
+    {
+        size_t n = 1;
+        while (n < capacity) n <<= 1;
+        mask = n - 1;
+        slots = make_unique<Slot[]>(n);
+        for (size_t i = 0; i < n; ++i)
+            slots[i].seq.store(i, memory_order_relaxed);
+
+        drainer = jthread{ [this](stop_token stop) { drain(stop); } };
+    }
+
+    void publish(const BankEvent& e) override
+    {
+        size_t pos = head.load(memory_order_relaxed);
+        Slot* slot;
+        for (;;)
+        {
+            slot = &slots[pos & mask];
+            size_t seq = slot->seq.load(memory_order_acquire);
+            auto diff = static_cast<ptrdiff_t>(seq) - static_cast<ptrdiff_t>(pos);
+            if (diff == 0)
+            {
+                if (head.compare_exchange_weak(pos, pos + 1, memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+            {
+                // the drain thread is a whole lap behind
+                lost.fetch_add(1, memory_order_relaxed);
+                return;
+            }
+            else
+            {
+                pos = head.load(memory_order_relaxed);
+            }
+        }
+        slot->event = e;
+        slot->seq.store(pos + 1, memory_order_release);
+    }
+
+    size_t dropped() const { return lost.load(memory_order_relaxed); }
+
+private:
+    bool pop_one()
+    {
+        Slot& slot = slots[tail & mask];
+        if (slot.seq.load(memory_order_acquire) != tail + 1)
+            return false;
+        out << slot.event;
+        slot.seq.store(tail + mask + 1, memory_order_release);
+        ++tail;
+        return true;
+    }
+
+    void drain(stop_token stop)
+    {
+        while (!stop.stop_requested())
+        {
+            if (!pop_one())
+                this_thread::sleep_for(chrono::microseconds(50));
+        }
+        // whatever was published before the sink is destroyed still goes out
+        while (pop_one()) {}
+        out.flush();
+    }
+};
@@ -0,0 +1,37 @@
+#include <iostream>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "shardedledger.hpp"
+using namespace std;
+
+// Throughput of the sharded ledger for a few shard counts, same total work
+// usage: ./ledger [total ops] [cross shard %] [shard counts...]
+int main(int argc, char* argv[])
+{
+    const size_t total_ops = argc > 1 ? stoul(argv[1]) : 8'000'000;
+    const int cross_percent = argc > 2 ? stoi(argv[2]) : 10;
+    vector<size_t> shard_counts;
+    for (int i = 3; i < argc; ++i) shard_counts.push_back(stoul(argv[i]));
+    if (shard_counts.empty()) shard_counts = { 1, 8, 64 };
+
+    const size_t accounts = 65536;
+    for (size_t shards : shard_counts)
+    {
+        ShardedLedger ledger{ shards, accounts / shards, 1000 };
+
+        auto start = chrono::steady_clock::now();
+        auto stats = ledger.run(total_ops / shards, cross_percent);
+        chrono::duration<double> took = chrono::steady_clock::now() - start;
+
+        long total = 0;
+        for (size_t a = 0; a < ledger.size(); ++a) total += ledger.account(a).balance;
+
+        size_t done = stats.local_commands + stats.cross_committed + stats.cross_aborted + stats.refused;
+        cout << shards << " shards: " << done / took.count() / 1e6 << " M commands/s, "
+             << stats.cross_committed << " cross shard transfers committed, "
+             << stats.cross_aborted << " aborted, total balance "
+             << (total == 1000L * long(ledger.size()) + stats.net_deposited ? "adds up" : "BROKEN") << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,254 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "bankaccount.hpp"
+using namespace std;
+
+// Accepts commands from any number of producer threads and calls them on one
+// executor thread, so the accounts never see two commands at once.
+//
+// Commands wait in priority lanes, each lane has a latency SLO (how long a
+// command may wait). Interactive commands go first. So that a steady
+// interactive stream can't starve bulk work, after `bulk_every` interactive
+// batches in a row with bulk commands waiting, one bulk batch runs.
+//
+// The SLOs override that order: a lane whose oldest command has used up 3/4
+// of its SLO, but not all of it yet, is served next, the one closest to its
+// deadline first. A command already past its SLO is a miss whatever runs
+// next, so it gets no say; promoting it would only make the other lane miss
+// too.
+//
+// When a command is picked the next few queued commands of the same lane on
+// the same account are taken with it and run back to back (a batch), capped
+// so a bulk batch can only delay interactive traffic by `max_batch` commands.
+class CommandScheduler
+{
+public:
+    enum Lane { interactive, bulk, lane_count };
+
+    struct LaneConfig
+    {
+        chrono::microseconds slo;
+        size_t max_batch;
+    };
+
+    // wait times are kept in power of 2 microsecond buckets
+    static constexpr size_t buckets = 32;
+
+    struct LaneMetrics
+    {
+        size_t depth = 0;
+        size_t submitted = 0;
+        size_t executed = 0;
+        size_t batches = 0;
+        size_t slo_misses = 0;
+        chrono::microseconds max_wait{ 0 };
+        array<size_t, buckets> wait_histogram{};
+
+        // upper bound of the bucket the p-th percentile falls in
+        chrono::microseconds percentile(double p) const
+        {
+            size_t total = 0;
+            for (auto n : wait_histogram) total += n;
+            size_t rank = static_cast<size_t>(p / 100.0 * total), seen = 0;
+            for (size_t b = 0; b < buckets; ++b)
+            {
+                seen += wait_histogram[b];
+                if (seen > rank) return min(chrono::microseconds{ 1ll << b }, max_wait);
+            }
+            return max_wait;
+        }
+    };
+
+private:
+    using clock = chrono::steady_clock;
+
+    struct Entry
+    {
+        shared_ptr<Command> cmd;
+        const BankAccount* key;
+        clock::time_point queued;
+    };
+
+    struct LaneState
+    {
+        LaneConfig config;
+        deque<Entry> queue;
+        LaneMetrics metrics;    // guarded by `m` like the queue
+    };
+
+    static constexpr size_t scan_window = 256;   // how far to look for same account commands
+
+    mutex m;
+    condition_variable wake, idle;
+    array<LaneState, lane_count> lanes;
+    size_t bulk_every;
+    size_t interactive_streak = 0;      // interactive batches run since bulk's last turn
+    bool busy = false;
+    bool stopping = false;
+    jthread executor;
+
+public:
+    explicit CommandScheduler(LaneConfig interactive_lane = { chrono::milliseconds(1), 4 },
+                              LaneConfig bulk_lane = { chrono::milliseconds(100), 64 },
+                              size_t bulk_every = 8)
+        : bulk_every(max<size_t>(bulk_every, 1))
+    {
+        lanes[interactive].config = interactive_lane;
+        lanes[bulk].config = bulk_lane;
+        executor = jthread{ [this] { run(); } };
+    }
+
+    // commands still queued are called before it returns
+    ~CommandScheduler()
+    {
+        {
+            lock_guard<mutex> lock{ m };
+            stopping = true;
+        }
+        wake.notify_one();
+    }
+
+    // `account` is the account the command works on, commands on the same
+    // account in the same lane are called in the order they were submitted
+    void submit(Lane lane, const BankAccount& account, shared_ptr<Command> cmd)
+    {
+        {
+            lock_guard<mutex> lock{ m };
+            auto& l = lanes[lane];
+            l.queue.push_back({ move(cmd), &account, clock::now() });
+            ++l.metrics.submitted;
+        }
+        wake.notify_one();
+    }
+
+    void submit(Lane lane, shared_ptr<BankAccountCommand> cmd)
+    {
+        auto& account = cmd->account;
+        submit(lane, account, move(cmd));
+    }
+
+    // blocks until everything submitted so far has been called
+    void drain()
+    {
+        unique_lock<mutex> lock{ m };
+        idle.wait(lock, [&] {
+            return !busy && all_of(lanes.begin(), lanes.end(),
+                [](const LaneState& l) { return l.queue.empty(); });
+        });
+    }
+
+    LaneMetrics metrics(Lane lane)
+    {
+        lock_guard<mutex> lock{ m };
+        auto snapshot = lanes[lane].metrics;
+        snapshot.depth = lanes[lane].queue.size();
+        return snapshot;
+    }
+
+private:
+    // A lane about to miss its SLO, else interactive first unless bulk is
+    // owed its turn; -1 when both are empty.
+    int pick_lane() const
+    {
+        auto now = clock::now();
+        int urgent = -1;
+        clock::duration least_slack = clock::duration::max();
+        for (int lane = 0; lane < lane_count; ++lane)
+        {
+            auto& l = lanes[lane];
+            if (l.queue.empty()) continue;
+            auto slack = l.queue.front().queued + l.config.slo - now;
+            if (slack >= clock::duration::zero() && slack < l.config.slo / 4 && slack < least_slack)
+            {
+                urgent = lane;
+                least_slack = slack;
+            }
+        }
+        if (urgent >= 0) return urgent;
+
+        bool has_interactive = !lanes[interactive].queue.empty();
+        bool has_bulk = !lanes[bulk].queue.empty();
+        if (has_interactive && (!has_bulk || interactive_streak < bulk_every)) return interactive;
+        return has_bulk ? bulk : -1;
+    }
+
+    // head of the lane plus later commands on the same account
+    vector<Entry> take_batch(LaneState& l)
+    {
+        vector<Entry> batch;
+        batch.push_back(move(l.queue.front()));
+        l.queue.pop_front();
+
+        auto key = batch.front().key;
+        size_t window = min(scan_window, l.queue.size());
+        for (size_t i = 0; i < window && batch.size() < l.config.max_batch;)
+        {
+            if (l.queue[i].key == key)
+            {
+                batch.push_back(move(l.queue[i]));
+                l.queue.erase(l.queue.begin() + i);
+                --window;
+            }
+            else
+            {
+                ++i;
+            }
+        }
+        return batch;
+    }
+
+    void record(LaneState& l, const vector<Entry>& batch, clock::time_point started)
+    {
+        auto& mt = l.metrics;
+        ++mt.batches;
+        for (auto& e : batch)
+        {
+            auto wait = chrono::duration_cast<chrono::microseconds>(started - e.queued);
+            ++mt.executed;
+            if (wait > l.config.slo) ++mt.slo_misses;
+            mt.max_wait = max(mt.max_wait, wait);
+            size_t b = bit_width(static_cast<uint64_t>(wait.count()));
+            ++mt.wait_histogram[min(b, buckets - 1)];
+        }
+    }
+
+    void run()
+    {
+        unique_lock<mutex> lock{ m };
+        for (;;)
+        {
+            int lane;
+            wake.wait(lock, [&] { return (lane = pick_lane()) >= 0 || stopping; });
+            if (lane < 0) return;           // stopping, and nothing left to call
+
+            if (lane == interactive && !lanes[bulk].queue.empty())
+                ++interactive_streak;
+            else
+                interactive_streak = 0;
+            auto& l = lanes[lane];
+            auto batch = take_batch(l);
+            busy = true;
+            auto started = clock::now();
+
+            lock.unlock();
+            for (auto& e : batch) e.cmd->call();
+            lock.lock();
+
+            record(l, batch, started);
+            busy = false;
+            idle.notify_all();
+        }
+    }
+};
@@ -0,0 +1,68 @@
+#include <iostream>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "bankaccount.hpp"
+#include "eventsink.hpp"
+#include "scheduler.hpp"
+using namespace std;
+
+// A few bulk settlement producers flood the scheduler while one interactive
+// producer submits a command every 100us. Interactive waits should stay
+// within their SLO regardless of the bulk backlog.
+// usage: ./scheduling [bulk producers] [bulk commands each]
+
+void report(const string& name, const CommandScheduler::LaneMetrics& mt)
+{
+    cout << name << ": " << mt.executed << " executed in " << mt.batches << " batches, "
+         << "depth " << mt.depth << ", wait p50 <= " << mt.percentile(50).count()
+         << "us p99 <= " << mt.percentile(99).count() << "us max " << mt.max_wait.count()
+         << "us, " << mt.slo_misses << " over SLO\n";
+}
+
+int main(int argc, char* argv[])
+{
+    const unsigned bulk_producers = argc > 1 ? stoul(argv[1]) : 4;
+    const size_t bulk_each = argc > 2 ? stoul(argv[2]) : 200'000;
+
+    NullSink quiet;
+    vector<BankAccount> bank(256);
+    for (auto& ba : bank) ba.events = &quiet;
+
+    CommandScheduler scheduler;
+    {
+        vector<jthread> producers;
+        for (unsigned p = 0; p < bulk_producers; ++p)
+        {
+            producers.emplace_back([&, p] {
+                mt19937 rng{ p };
+                for (size_t i = 0; i < bulk_each; ++i)
+                {
+                    // settlement runs account by account, lots of batching
+                    auto& ba = bank[(i / 32 + p * 64) % bank.size()];
+                    scheduler.submit(CommandScheduler::bulk,
+                        make_shared<BankAccountCommand>(ba, BankAccountCommand::deposit, 1 + rng() % 100));
+                }
+            });
+        }
+
+        producers.emplace_back([&] {
+            mt19937 rng{ 99 };
+            for (int i = 0; i < 2000; ++i)
+            {
+                auto& ba = bank[rng() % bank.size()];
+                scheduler.submit(CommandScheduler::interactive,
+                    make_shared<BankAccountCommand>(ba, BankAccountCommand::withdraw, 1 + rng() % 10));
+                this_thread::sleep_for(chrono::microseconds(100));
+            }
+        });
+    }
+    scheduler.drain();
+
+    report("interactive", scheduler.metrics(CommandScheduler::interactive));
+    report("bulk       ", scheduler.metrics(CommandScheduler::bulk));
+    return 0;
+}
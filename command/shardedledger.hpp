@@ -0,0 +1,447 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <pthread.h>
+#include "bankaccount.hpp"
+#include "eventsink.hpp"
+using namespace std;
+
+// Bounded single producer / single consumer ring. Producer and consumer each
+// own one index, the other side only reads it, so no compare-and-swap needed.
+template <typename T>
+class SpscQueue
+{
+    size_t mask;
+    unique_ptr<T[]> items;
+    alignas(64) atomic<size_t> head{ 0 };    // written by the producer
+    alignas(64) atomic<size_t> tail{ 0 };    // written by the consumer
+
+public:
+    explicit SpscQueue(size_t capacity)
+    {
+        size_t n = 1;
+        while (n < capacity) n <<= 1;
+        mask = n - 1;
+        items = make_unique<T[]>(n);
+    }
+
+    bool push(const T& item)
+    {
+        size_t h = head.load(memory_order_relaxed);
+        if (h - tail.load(memory_order_acquire) > mask) return false;
+        items[h & mask] = item;
+        head.store(h + 1, memory_order_release);
+        return true;
+    }
+
+    bool pop(T& item)
+    {
+        size_t t = tail.load(memory_order_relaxed);
+        if (t == head.load(memory_order_acquire)) return false;
+        item = items[t & mask];
+        tail.store(t + 1, memory_order_release);
+        return true;
+    }
+};
+
+// Accounts split over shards, shard s owns the global accounts
+// [s * accounts_per_shard, (s + 1) * accounts_per_shard). Each shard is run by
+// exactly one thread, so commands on its own accounts are plain
+// BankAccountCommand / MoneyTransferCommand calls with no locking.
+//
+// Any thread can submit() a deposit, withdrawal or transfer; it is queued on
+// the shard that owns the source account and run by that shard's thread.
+//
+// A MoneyTransferCommand to an account on another shard is run in two phases
+// over the SPSC queue between the 2 shard threads:
+//   1. prepare  the source shard calls the transfer's withdraw (the money is
+//               now "in flight") and sends Prepare to the destination shard
+//   2. commit   the destination calls the transfer's deposit and answers
+//               Commit, or answers Abort if it can't take the money, in which
+//               case the source calls undo() on the transfer
+// Each half only touches its own shard's account, the transfer itself stays
+// with the source shard until it is settled.
+class ShardedLedger
+{
+public:
+    struct Message
+    {
+        enum Kind : uint8_t { prepare, commit, abort } kind;
+        uint64_t txid;
+        MoneyTransferCommand* transfer;   // owned by the source shard
+    };
+
+    struct Stats
+    {
+        size_t local_commands = 0;
+        size_t cross_committed = 0;
+        size_t cross_aborted = 0;
+        size_t refused = 0;   // withdraw failed before anything was sent
+        long net_deposited = 0; // by plain deposits/withdrawals, transfers move money around
+    };
+
+    // how many submitted orders a shard holds before submit() waits
+    static constexpr size_t inbound_capacity = 4096;
+
+private:
+    struct Order
+    {
+        enum Kind : uint8_t { deposit, withdraw, transfer } kind;
+        int amount;
+        size_t account, to;
+    };
+
+    struct Shard
+    {
+        NullSink quiet;       // per shard, nothing is shared between threads
+        vector<BankAccount> accounts;
+        unordered_map<uint64_t, MoneyTransferCommand> in_flight;
+        vector<deque<Message>> outbox;   // messages the peer's queue had no room for
+        uint64_t next_txid = 0;
+        Stats stats;
+        size_t done = 0;                 // orders settled, only the shard's thread counts
+
+        // filled by submit() from any thread
+        alignas(64) mutex inbound_lock;
+        vector<Order> inbound;
+        size_t accepted = 0;             // orders ever submitted, under inbound_lock
+
+        alignas(64) atomic<size_t> settled{ 0 };    // `done`, published for drain()
+        atomic<uint32_t> bell{ 0 };      // rung for new orders or messages
+    };
+
+    size_t shard_count, accounts_per_shard;
+    vector<unique_ptr<Shard>> shards;
+    // queues[from * shard_count + to]
+    vector<unique_ptr<SpscQueue<Message>>> queues;
+    atomic<bool> stopping{ false };
+    vector<jthread> threads;
+
+public:
+    ShardedLedger(size_t shard_count, size_t accounts_per_shard, int opening_balance,
+                  size_t queue_capacity = 256)
+        : shard_count(max<size_t>(shard_count, 1)), accounts_per_shard(max<size_t>(accounts_per_shard, 1))
+    {
+        for (size_t s = 0; s < this->shard_count; ++s)
+        {
+            auto shard = make_unique<Shard>();
+            shard->accounts.resize(this->accounts_per_shard);
+            shard->outbox.resize(this->shard_count);
+            for (auto& ba : shard->accounts)
+            {
+                ba.balance = opening_balance;
+                ba.events = &shard->quiet;
+            }
+            shards.push_back(move(shard));
+        }
+        for (size_t q = 0; q < this->shard_count * this->shard_count; ++q)
+            queues.push_back(make_unique<SpscQueue<Message>>(queue_capacity));
+        for (size_t s = 0; s < this->shard_count; ++s)
+            threads.emplace_back([=, this] { shard_main(s); });
+    }
+
+    // runs what was submitted, then stops the shard threads
+    ~ShardedLedger()
+    {
+        drain();
+        stopping = true;
+        for (size_t s = 0; s < shard_count; ++s) ring(s);
+        threads.clear();
+    }
+
+    size_t size() const { return shard_count * accounts_per_shard; }
+
+    // Only safe to look at while no orders are running, e.g. after drain().
+    BankAccount& account(size_t global)
+    {
+        return shards[global / accounts_per_shard]->accounts[global % accounts_per_shard];
+    }
+
+    // Queues a transfer on the shard that owns `from`, a MoneyTransferCommand
+    // run there, or in two phases if `to` is on another shard. False if either
+    // isn't an account.
+    bool submit(size_t from, size_t to, int amount)
+    {
+        if (from >= size() || to >= size()) return false;
+        enqueue({ Order::transfer, amount, from, to });
+        return true;
+    }
+
+    // queues a deposit or withdrawal, false if `account` isn't one
+    bool submit(size_t account, BankAccountCommand::Action action, int amount)
+    {
+        if (account >= size()) return false;
+        enqueue({ action == BankAccountCommand::deposit ? Order::deposit : Order::withdraw, amount, account, 0 });
+        return true;
+    }
+
+    // waits until everything submitted before it has run, cross shard
+    // transfers committed or aborted
+    void drain()
+    {
+        for (auto& shard : shards)
+        {
+            for (;;)
+            {
+                size_t wanted;
+                {
+                    lock_guard l{ shard->inbound_lock };
+                    wanted = shard->accepted;
+                }
+                size_t done = shard->settled.load();
+                if (done >= wanted) break;
+                shard->settled.wait(done);
+            }
+        }
+    }
+
+    // counted since the ledger was made, only complete after drain()
+    Stats stats()
+    {
+        Stats total;
+        for (auto& shard : shards)
+        {
+            total.local_commands += shard->stats.local_commands;
+            total.cross_committed += shard->stats.cross_committed;
+            total.cross_aborted += shard->stats.cross_aborted;
+            total.refused += shard->stats.refused;
+            total.net_deposited += shard->stats.net_deposited;
+        }
+        return total;
+    }
+
+    // A workload driver: one producer thread per shard submits
+    // `ops_per_shard` random commands on that shard's accounts,
+    // `cross_percent` of them transfers to a random account anywhere.
+    // Returns the stats once every shard is idle.
+    Stats run(size_t ops_per_shard, int cross_percent, int transfer_percent = 50)
+    {
+        {
+            vector<jthread> producers;
+            for (size_t s = 0; s < shard_count; ++s)
+                producers.emplace_back([=, this] { produce(s, ops_per_shard, cross_percent, transfer_percent); });
+        }
+        drain();
+        return stats();
+    }
+
+private:
+    SpscQueue<Message>& queue(size_t from, size_t to)
+    {
+        return *queues[from * shard_count + to];
+    }
+
+    size_t shard_of(size_t global) const { return global / accounts_per_shard; }
+
+    void ring(size_t s)
+    {
+        shards[s]->bell.fetch_add(1);
+        shards[s]->bell.notify_one();
+    }
+
+    void enqueue(const Order& order)
+    {
+        size_t s = shard_of(order.account);
+        Shard& shard = *shards[s];
+        for (;;)
+        {
+            {
+                lock_guard l{ shard.inbound_lock };
+                if (shard.inbound.size() < inbound_capacity)
+                {
+                    shard.inbound.push_back(order);
+                    ++shard.accepted;
+                    break;
+                }
+            }
+            this_thread::yield();
+        }
+        ring(s);
+    }
+
+    // Never waits for the receiver: two shards blocked sending to each other
+    // with full queues would deadlock. What doesn't fit is kept in the outbox
+    // and retried on the next poll().
+    void send(size_t from, size_t to, const Message& m)
+    {
+        auto& waiting = shards[from]->outbox[to];
+        if (!waiting.empty() || !queue(from, to).push(m))
+            waiting.push_back(m);
+        else
+            ring(to);
+    }
+
+    // runs one order on shard `self`, the one that owns order.account
+    void execute(size_t self, const Order& order)
+    {
+        Shard& me = *shards[self];
+        auto& from = me.accounts[order.account % accounts_per_shard];
+        if (order.kind != Order::transfer)
+        {
+            BankAccountCommand cmd{ from, order.kind == Order::deposit ? BankAccountCommand::deposit
+                                                                       : BankAccountCommand::withdraw, order.amount };
+            cmd.call();
+            if (cmd.succeeded)
+                me.stats.net_deposited += cmd.action == BankAccountCommand::deposit ? order.amount : -order.amount;
+            ++me.stats.local_commands;
+            ++me.done;
+            return;
+        }
+
+        size_t to_shard = shard_of(order.to);
+        if (to_shard == self)
+        {
+            MoneyTransferCommand transfer{ from, account(order.to), order.amount };
+            transfer.call();
+            ++me.stats.local_commands;
+            ++me.done;
+            return;
+        }
+
+        // phase 1, the money leaves the source account
+        uint64_t txid = me.next_txid++;
+        auto& transfer = me.in_flight.try_emplace(txid, from, account(order.to), order.amount).first->second;
+        auto& debit = transfer[0];
+        debit.call();
+        if (!debit.succeeded)
+        {
+            me.in_flight.erase(txid);
+            ++me.stats.refused;
+            ++me.done;
+            return;
+        }
+        send(self, to_shard, { Message::prepare, txid, &transfer });
+    }
+
+    // handles everything waiting for shard `self`, returns whether there was any
+    bool poll(size_t self)
+    {
+        Shard& me = *shards[self];
+        bool any = false;
+        for (size_t to = 0; to < shard_count; ++to)
+        {
+            auto& waiting = me.outbox[to];
+            if (waiting.empty()) continue;
+            while (!waiting.empty() && queue(self, to).push(waiting.front()))
+                waiting.pop_front();
+            ring(to);
+        }
+
+        Message m;
+        for (size_t from = 0; from < shard_count; ++from)
+        {
+            auto& q = queue(from, self);
+            while (q.pop(m))
+            {
+                any = true;
+                switch (m.kind)
+                {
+                case Message::prepare:
+                {
+                    // phase 2, on this shard's account
+                    auto& credit = (*m.transfer)[1];
+                    credit.call();
+                    send(self, from, { credit.succeeded ? Message::commit : Message::abort, m.txid, m.transfer });
+                    break;
+                }
+                case Message::commit:
+                    me.in_flight.erase(m.txid);
+                    ++me.stats.cross_committed;
+                    ++me.done;
+                    break;
+                case Message::abort:
+                {
+                    auto it = me.in_flight.find(m.txid);
+                    it->second.undo();
+                    me.in_flight.erase(it);
+                    ++me.stats.cross_aborted;
+                    ++me.done;
+                    break;
+                }
+                }
+            }
+        }
+        return any;
+    }
+
+    void shard_main(size_t self)
+    {
+        // one shard per core where possible
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(self % max(1u, thread::hardware_concurrency()), &cpus);
+        pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+
+        Shard& me = *shards[self];
+        vector<Order> orders;
+        size_t idle = 0;
+        for (;;)
+        {
+            // anything queued after this changes the bell, so the wait below
+            // can't miss it
+            uint32_t seen = me.bell.load();
+            {
+                lock_guard l{ me.inbound_lock };
+                orders.swap(me.inbound);
+            }
+            for (size_t i = 0; i < orders.size(); ++i)
+            {
+                execute(self, orders[i]);
+                if ((i & 63) == 63) poll(self);
+            }
+            bool busy = !orders.empty();
+            orders.clear();
+            busy |= poll(self);
+
+            if (me.done != me.settled.load(memory_order_relaxed))
+            {
+                me.settled.store(me.done);
+                me.settled.notify_all();
+            }
+            if (busy)
+            {
+                idle = 0;
+                continue;
+            }
+            if (stopping) return;
+            // A peer's answer or more orders usually come right after, give
+            // them a few chances before going to sleep. Not with messages in
+            // the outbox: nobody rings when the peer's queue has room again.
+            bool stalled = any_of(me.outbox.begin(), me.outbox.end(), [](auto& o) { return !o.empty(); });
+            if (stalled || ++idle < 64)
+                this_thread::yield();
+            else
+                me.bell.wait(seen);
+        }
+    }
+
+    void produce(size_t shard, size_t ops, int cross_percent, int transfer_percent)
+    {
+        mt19937 rng{ static_cast<unsigned>(shard) + 1 };
+        uniform_int_distribution<size_t> local{ 0, accounts_per_shard - 1 }, global{ 0, size() - 1 };
+        uniform_int_distribution<int> percent{ 0, 99 }, amount{ 1, 100 };
+        size_t first = shard * accounts_per_shard;
+
+        for (size_t i = 0; i < ops; ++i)
+        {
+            size_t from = first + local(rng);
+            int amt = amount(rng);
+            size_t to = global(rng);
+
+            if (percent(rng) < cross_percent && shard_of(to) != shard)
+                submit(from, to, amt);
+            else if (percent(rng) < transfer_percent)
+                submit(from, first + local(rng), amt);
+            else
+                submit(from, percent(rng) < 50 ? BankAccountCommand::deposit : BankAccountCommand::withdraw, amt);
+        }
+    }
+};
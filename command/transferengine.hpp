@@ -0,0 +1,135 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "bankaccount.hpp"
+using namespace std;
+
+// Runs bank account commands from many threads at once.
+// Every account hashes onto one of `Stripes` mutexes, a command locks all of
+// the stripes it touches in ascending index order (so two transfers can never
+// wait on each other in a cycle) and only then calls/undoes its sub-commands.
+template <size_t Stripes = 256>
+class TransferEngine
+{
+    static_assert((Stripes & (Stripes - 1)) == 0, "stripe count must be a power of 2");
+
+    // one mutex per cache line, otherwise neighbouring stripes false share
+    struct alignas(64) Stripe { mutex m; };
+    array<Stripe, Stripes> stripes;
+
+    static size_t stripe_of(const BankAccount& account)
+    {
+        // fibonacci hashing, accounts stored next to each other in a vector
+        // end up spread over the stripes instead of sharing one
+        auto p = reinterpret_cast<uintptr_t>(&account);
+        return static_cast<size_t>((p * 0x9E3779B97F4A7C15ull) >> 32) & (Stripes - 1);
+    }
+
+    template <typename F>
+    void locked(const CompositeBankAccountCommand& cmd, F&& f)
+    {
+        // the distinct stripes, ascending; thread_local so it only
+        // allocates until it has grown to the largest command seen
+        thread_local vector<size_t> wanted;
+        wanted.clear();
+        for (auto& c : cmd)
+            wanted.push_back(stripe_of(c.account));
+        sort(wanted.begin(), wanted.end());
+        wanted.erase(unique(wanted.begin(), wanted.end()), wanted.end());
+
+        // held until this returns, also if f() throws; a transfer needs 2,
+        // only bigger commands spill into the vector
+        array<unique_lock<mutex>, 4> held;
+        vector<unique_lock<mutex>> more;
+        for (size_t k = 0; k < wanted.size(); ++k)
+        {
+            unique_lock<mutex> lock{ stripes[wanted[k]].m };
+            if (k < held.size()) held[k] = move(lock);
+            else more.push_back(move(lock));
+        }
+        f();
+    }
+
+public:
+    void call(BankAccountCommand& cmd)
+    {
+        lock_guard<mutex> lock{ stripes[stripe_of(cmd.account)].m };
+        cmd.call();
+    }
+
+    void undo(BankAccountCommand& cmd)
+    {
+        lock_guard<mutex> lock{ stripes[stripe_of(cmd.account)].m };
+        cmd.undo();
+    }
+
+    // works for DependentCompositeCommand and MoneyTransferCommand too,
+    // call() is virtual so the dependent rules still apply
+    void call(CompositeBankAccountCommand& cmd)
+    {
+        locked(cmd, [&] { cmd.call(); });
+    }
+
+    // Undo is all or nothing: undoing a deposit is a withdraw which may hit the
+    // overdraft limit if the money has been moved on since. In that case the
+    // legs already undone are re-applied and false is returned. Legs that were
+    // undone lose their `succeeded` flag, so undoing twice changes nothing.
+    bool undo(CompositeBankAccountCommand& cmd)
+    {
+        bool ok = true;
+        locked(cmd, [&] {
+            auto it = cmd.rbegin();
+            for (; it != cmd.rend(); ++it)
+            {
+                if (!it->succeeded) continue;
+                if (it->action == BankAccountCommand::deposit)
+                {
+                    if (!it->account.withdraw(it->amount)) { ok = false; break; }
+                }
+                else
+                {
+                    it->account.deposit(it->amount);
+                }
+            }
+            if (ok)
+            {
+                for (auto& c : cmd) c.succeeded = false;
+                return;
+            }
+
+            // put back whatever was undone before the failing leg
+            for (auto back = it.base(); back != cmd.end(); ++back)
+            {
+                if (!back->succeeded) continue;
+                if (back->action == BankAccountCommand::deposit)
+                    back->account.deposit(back->amount);
+                else
+                    back->account.withdraw(back->amount);
+            }
+        });
+        return ok;
+    }
+
+    // Calls every command once, spread over `threads` workers. Workers grab
+    // small chunks from a shared counter so a slow chunk doesn't hold up the rest.
+    template <typename Cmd>
+    void run(vector<Cmd>& cmds, unsigned threads)
+    {
+        constexpr size_t chunk = 64;
+        atomic<size_t> next{ 0 };
+        vector<jthread> workers;
+        for (unsigned t = 0; t < threads; ++t)
+        {
+            workers.emplace_back([&] {
+                for (size_t i; (i = next.fetch_add(chunk)) < cmds.size();)
+                    for (size_t j = i; j < min(i + chunk, cmds.size()); ++j)
+                        call(cmds[j]);
+            });
+        }
+    }
+};
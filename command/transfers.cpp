@@ -0,0 +1,96 @@
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include <numeric>
+#include <thread>
+#include "bankaccount.hpp"
+#include "eventsink.hpp"
+#include "transferengine.hpp"
+using namespace std;
+
+// Randomized transfer workload: fewer accounts = more contention
+// usage: ./transfers [accounts] [transfers] [max threads] [null|buffered|ring]
+// buffered and ring write the account events to transfers.log
+int main(int argc, char* argv[])
+{
+    const size_t accounts  = argc > 1 ? stoul(argv[1]) : 1000;
+    const size_t transfers = argc > 2 ? stoul(argv[2]) : 1'000'000;
+    const unsigned max_threads = argc > 3 ? stoul(argv[3])
+                                          : max(1u, thread::hardware_concurrency());
+    const string sink_kind = argc > 4 ? argv[4] : "null";
+    if (accounts < 1)
+    {
+        cerr << "usage: ./transfers [accounts] [transfers] [max threads] [null|buffered|ring], at least 1 account\n";
+        return 1;
+    }
+
+    for (unsigned threads = 1; threads <= max_threads; threads *= 2)
+    {
+        vector<BankAccount> bank(accounts);
+        ofstream log;
+        unique_ptr<BankEventSink> sink;
+        if (sink_kind == "buffered" || sink_kind == "ring")
+        {
+            log.open("transfers.log");
+            if (sink_kind == "ring") sink = make_unique<RingBufferSink>(log);
+            else                     sink = make_unique<BufferedSink>(log);
+        }
+        else
+        {
+            sink = make_unique<NullSink>();
+        }
+
+        for (auto& ba : bank)
+        {
+            ba.balance = 1000;
+            ba.events = sink.get();
+        }
+
+        mt19937 rng{ 42 };
+        uniform_int_distribution<size_t> pick{ 0, accounts - 1 };
+        uniform_int_distribution<int> amount{ 1, 100 };
+
+        vector<MoneyTransferCommand> cmds;
+        cmds.reserve(transfers);
+        for (size_t i = 0; i < transfers; ++i)
+        {
+            size_t from = pick(rng), to = pick(rng);
+            while (to == from && accounts > 1) to = pick(rng);
+            cmds.emplace_back(bank[from], bank[to], amount(rng));
+        }
+
+        TransferEngine engine;
+        auto start = chrono::steady_clock::now();
+        engine.run(cmds, threads);
+        chrono::duration<double> took = chrono::steady_clock::now() - start;
+
+        // undo everything concurrently as well, an undo that would break an
+        // overdraft limit is refused as a whole so money is never created
+        size_t refused = 0;
+        {
+            atomic<size_t> failed{ 0 };
+            vector<jthread> workers;
+            for (unsigned t = 0; t < threads; ++t)
+                workers.emplace_back([&, t] {
+                    for (size_t i = t; i < cmds.size(); i += threads)
+                        if (!engine.undo(cmds[i])) ++failed;
+                });
+            workers.clear();
+            refused = failed;
+        }
+
+        long total = accumulate(bank.begin(), bank.end(), 0L,
+            [](long sum, const BankAccount& ba) { return sum + ba.balance; });
+
+        cout << threads << " threads: "
+             << transfers / took.count() / 1e6 << " M transfers/s, "
+             << refused << " undos refused, total balance "
+             << (total == 1000L * long(accounts) ? "conserved" : "BROKEN") << "\n";
+    }
+
+    return 0;
+}
@@ -0,0 +1,86 @@
+#include "user.hpp"
+#include "chatroom.hpp"
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <random>
+
+// Private messages in a room with 100k users
+// usage: ./bench [users] [messages]
+int main(int argc, char* argv[])
+{
+    const size_t user_count = argc > 1 ? stoul(argv[1]) : 100'000;
+    const size_t messages = argc > 2 ? stoul(argv[2]) : 1'000'000;
+    using clock = chrono::steady_clock;
+
+    ChatRoom room;
+    vector<unique_ptr<User>> users;
+    for (size_t i = 0; i < user_count; ++i)
+    {
+        users.push_back(make_unique<User>("user" + to_string(i)));
+        users.back()->echo = false;
+        room.join(users.back().get(), false);
+    }
+
+    mt19937 rng{ 1 };
+    uniform_int_distribution<size_t> pick{ 0, user_count - 1 };
+
+    // the old lookup: scan the users vector comparing names
+    const size_t scans = 1000;
+    size_t found = 0;
+    auto start = clock::now();
+    for (size_t i = 0; i < scans; ++i)
+    {
+        string who = "user" + to_string(pick(rng));
+        auto target = find_if(begin(room.users), end(room.users),
+                              [&](const User* u) { return u->name == who; });
+        found += target != end(room.users);
+    }
+    chrono::duration<double, nano> scanning = clock::now() - start;
+
+    start = clock::now();
+    for (size_t i = 0; i < scans; ++i)
+        found += room.find("user" + to_string(pick(rng))) != nullptr;
+    chrono::duration<double, nano> hashing = clock::now() - start;
+
+    // whole pm delivery through the mediator
+    vector<string> names(messages);
+    for (auto& n : names) n = "user" + to_string(pick(rng));
+    start = clock::now();
+    for (size_t i = 0; i < messages; ++i)
+        users[i % user_count]->pm(names[i], "hi");
+    chrono::duration<double, nano> delivering = clock::now() - start;
+
+    // broadcast in a 10k user room: a fresh formatted string per recipient
+    // (what receive used to do) against one shared message
+    const size_t room_size = min<size_t>(user_count, 10'000), broadcasts = 200;
+    ChatRoom small;
+    for (size_t i = 0; i < room_size; ++i)
+    {
+        users[i]->chat_log.clear();
+        small.join(users[i].get(), false);
+    }
+    const string text = "the quick brown fox jumps over the lazy dog, again and again";
+
+    vector<vector<string>> copied_logs(room_size);
+    start = clock::now();
+    for (size_t b = 0; b < broadcasts; ++b)
+        for (size_t i = 1; i < room_size; ++i)
+            copied_logs[i].emplace_back(string{ "user0" } + ": \"" + text + "\"");
+    chrono::duration<double, nano> copying = clock::now() - start;
+
+    start = clock::now();
+    for (size_t b = 0; b < broadcasts; ++b)
+        users[0]->say(text);
+    chrono::duration<double, nano> sharing = clock::now() - start;
+
+    cout << user_count << " users in the room\n"
+         << "  linear scan lookup: " << scanning.count() / scans << " ns\n"
+         << "  hash index lookup:  " << hashing.count() / scans << " ns\n"
+         << "  pm delivery:        " << delivering.count() / messages << " ns/message\n"
+         << "  (" << found << " lookups found)\n"
+         << room_size << " users, broadcast of a " << text.size() << " char message\n"
+         << "  string per recipient: " << copying.count() / broadcasts / 1000 << " us/broadcast\n"
+         << "  shared message:       " << sharing.count() / broadcasts / 1000 << " us/broadcast\n";
+    return 0;
+}
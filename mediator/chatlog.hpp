@@ -0,0 +1,202 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "journal.hpp"
+#include "message.hpp"
+using namespace std;
+
+// A user's chat log: the last `capacity` messages received, in a ring. When
+// it's full the oldest message is dropped, so a busy user's memory stays flat.
+//
+// The ring lives in the log itself, or in a slice of its room's LogArena
+// while the user is in a room that keeps history. Messages of such a room are
+// also in the room's ChatJournal, and what fell out of the ring is read back
+// from there with scrollback().
+class ChatLog
+{
+public:
+    static constexpr uint64_t unjournaled = UINT64_MAX;
+
+    struct Entry
+    {
+        uint64_t seq = unjournaled;    // position in the room's journal
+        MessagePtr message;
+    };
+
+private:
+    vector<Entry> own;
+    Entry* slots = nullptr;            // own.data() or an arena slice
+    bool borrowed = false;
+    size_t capacity;
+    size_t own_capacity;               // the log's own, while borrowing a slice
+    uint64_t received = 0;             // since the last clear()
+
+    const ChatJournal* journal = nullptr;
+    string owner;
+    uint64_t joined_at = 0;            // first journal entry after joining
+
+public:
+    explicit ChatLog(size_t capacity = 1024) : capacity(max<size_t>(capacity, 1)), own_capacity(this->capacity) {}
+
+    ChatLog(const ChatLog&) = delete;
+    ChatLog& operator=(const ChatLog&) = delete;
+
+    void push_back(MessagePtr message, uint64_t seq = unjournaled)
+    {
+        if (!borrowed && own.size() < capacity)
+        {
+            own.push_back({ seq, move(message) });
+            slots = own.data();
+        }
+        else
+        {
+            slots[received % capacity] = { seq, move(message) };
+        }
+        ++received;
+    }
+
+    size_t size() const { return static_cast<size_t>(min<uint64_t>(received, capacity)); }
+    bool empty() const { return received == 0; }
+    // everything received, including what the ring dropped
+    uint64_t total() const { return received; }
+
+    // i-th retained message, oldest first
+    const Entry& entry(size_t i) const { return slots[(received - size() + i) % capacity]; }
+    Entry& entry(size_t i) { return slots[(received - size() + i) % capacity]; }
+    const MessagePtr& operator[](size_t i) const { return entry(i).message; }
+
+    void clear()
+    {
+        for (size_t i = 0; i < size(); ++i)
+            slots[i] = {};
+        own.clear();
+        if (!borrowed) slots = nullptr;
+        received = 0;
+    }
+
+    // Up to `n` messages this user received before journal entry `before`
+    // (default: before the oldest message still in the ring), oldest first.
+    // Only what was sent while the user was in the room, read from disk.
+    vector<Entry> scrollback(size_t n, uint64_t before = unjournaled) const
+    {
+        vector<Entry> out;
+        if (!journal) return out;
+        if (before == unjournaled)
+        {
+            before = journal->size();
+            for (size_t i = 0; i < size(); ++i)
+                if (entry(i).seq != unjournaled)
+                {
+                    before = entry(i).seq;
+                    break;
+                }
+        }
+        for (uint64_t s = before; s > joined_at && out.size() < n;)
+        {
+            auto r = journal->read(--s);
+            if (sees(s, r))
+                out.push_back({ s, make_message(r.origin, r.text) });
+        }
+        reverse(out.begin(), out.end());
+        return out;
+    }
+
+    bool attached_to(const ChatJournal* j) const { return borrowed && journal == j; }
+
+    // whether journal entry `seq` (record `r`) was received by this user
+    bool sees(uint64_t seq, const ChatJournal::Record& r) const
+    {
+        return journal && seq >= joined_at && r.origin != owner && (r.to.empty() || r.to == owner);
+    }
+
+    // Moves the ring into `slice` (room sized `slice_capacity`), keeping the
+    // newest messages that fit. Used by ChatRoom on join.
+    void attach(Entry* slice, size_t slice_capacity, const ChatJournal* j, const string& name)
+    {
+        detach();
+        own_capacity = capacity;
+        size_t keep = min(size(), slice_capacity);
+        for (size_t i = 0; i < keep; ++i)
+            slice[i] = move(entry(size() - keep + i));
+        own = {};
+        slots = slice;
+        borrowed = true;
+        capacity = slice_capacity;
+        received = keep;
+        journal = j;
+        owner = name;
+        joined_at = j->size();
+    }
+
+    // Copies the ring out of the arena slice before the room takes it back,
+    // back to the log's own capacity, keeping the newest messages that fit.
+    void detach()
+    {
+        if (!borrowed) return;
+        size_t keep = min(size(), own_capacity);
+        vector<Entry> kept;
+        kept.reserve(own_capacity);
+        for (size_t i = size() - keep; i < size(); ++i)
+            kept.push_back(move(entry(i)));
+        received = kept.size();
+        own = move(kept);
+        slots = own.data();
+        borrowed = false;
+        capacity = own_capacity;
+        journal = nullptr;
+    }
+
+    struct const_iterator
+    {
+        const ChatLog* log;
+        size_t i;
+        const MessagePtr& operator*() const { return (*log)[i]; }
+        const_iterator& operator++() { ++i; return *this; }
+        bool operator==(const const_iterator&) const = default;
+    };
+    const_iterator begin() const { return { this, 0 }; }
+    const_iterator end() const { return { this, size() }; }
+};
+
+// Rings of `per_user` entries for all members of a room, allocated in blocks
+// of 64 users instead of one allocation per user. Slices of users who left
+// are reused.
+class LogArena
+{
+    static constexpr size_t slices_per_block = 64;
+
+    size_t per_user;
+    vector<unique_ptr<ChatLog::Entry[]>> blocks;
+    vector<ChatLog::Entry*> free_slices;
+    size_t used_in_last = slices_per_block;
+
+public:
+    explicit LogArena(size_t per_user) : per_user(max<size_t>(per_user, 1)) {}
+
+    size_t slice_size() const { return per_user; }
+
+    ChatLog::Entry* acquire()
+    {
+        if (!free_slices.empty())
+        {
+            auto slice = free_slices.back();
+            free_slices.pop_back();
+            return slice;
+        }
+        if (used_in_last == slices_per_block)
+        {
+            blocks.push_back(make_unique<ChatLog::Entry[]>(slices_per_block * per_user));
+            used_in_last = 0;
+        }
+        return blocks.back().get() + per_user * used_in_last++;
+    }
+
+    void release(ChatLog::Entry* slice)
+    {
+        fill(slice, slice + per_user, ChatLog::Entry{});
+        free_slices.push_back(slice);
+    }
+};
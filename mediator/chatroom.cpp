@@ -3,17 +3,105 @@
 
 void ChatRoom::broadcast(const string &origin, const string &message)
 {
+    broadcast(make_message(origin, message));
+}
+
+// one message object for the whole room, recipients share it
+void ChatRoom::broadcast(const MessagePtr &message)
+{
+    uint64_t seq = ChatLog::unjournaled;
+    if (history)
+    {
+        seq = history->journal.append(message->origin, "", message->text);
+        if (history->search) history->search->add(seq, message->text);
+    }
     for (auto u : users)
-        if (u->name != origin)
-            u->receive(origin, message);
+        if (u->name != message->origin)
+            u->receive(message, seq);
 }
 
-void ChatRoom::join(User *u)
+ChatRoom::~ChatRoom()
 {
-    string join_msg = u->name + " joins the chat";
-    broadcast("room", join_msg);
+    // the arena goes away with the room, members keep copies of their rings
+    if (history)
+        for (auto u : users)
+            if (u->chat_log.attached_to(&history->journal))
+                u->chat_log.detach();
+}
+
+void ChatRoom::keep_history(const filesystem::path &file, size_t per_user, bool searchable)
+{
+    if (history)
+        return;
+    history = make_unique<History>(file, per_user);
+    if (searchable)
+    {
+        history->search = make_unique<SearchIndex>();
+        for (uint64_t seq = 0; seq < history->journal.size(); ++seq)
+            history->search->add(seq, history->journal.read(seq).text);
+    }
+    for (auto u : users)
+    {
+        history->slices.push_back(history->arena.acquire());
+        u->chat_log.attach(history->slices.back(), per_user, &history->journal, u->name);
+    }
+}
+
+bool ChatRoom::join(User *u, bool announce)
+{
+    if (index.count(u->name))
+        return false;
+
+    if (announce)
+    {
+        string join_msg = u->name + " joins the chat";
+        broadcast("room", join_msg);
+    }
     u->room = this;
+    index.emplace(u->name, users.size());
     users.push_back(u);
+    if (history)
+    {
+        history->slices.push_back(history->arena.acquire());
+        u->chat_log.attach(history->slices.back(), history->arena.slice_size(),
+                           &history->journal, u->name);
+    }
+    return true;
+}
+
+void ChatRoom::leave(User *u, bool announce)
+{
+    auto it = index.find(u->name);
+    if (it == index.end() || users[it->second] != u)
+        return;
+
+    // move the last user into the gap, no shifting the whole vector
+    size_t pos = it->second;
+    index.erase(it);
+    if (history)
+    {
+        if (u->chat_log.attached_to(&history->journal))
+            u->chat_log.detach();
+        history->arena.release(history->slices[pos]);
+        history->slices[pos] = history->slices.back();
+        history->slices.pop_back();
+    }
+    if (pos + 1 != users.size())
+    {
+        users[pos] = users.back();
+        index[users[pos]->name] = pos;
+    }
+    users.pop_back();
+    u->room = nullptr;
+
+    if (announce)
+        broadcast("room", u->name + " leaves the chat");
+}
+
+User* ChatRoom::find(const string& name) const
+{
+    auto it = index.find(name);
+    return it == index.end() ? nullptr : users[it->second];
 }
 
 void ChatRoom::message(
@@ -21,14 +109,32 @@ void ChatRoom::message(
     const string& who,
     const string& message)
 {
-    auto target = std::find_if(
-        begin(users),
-        end(users),
-        [&](const User *u) { return u->name == who;
-    });
+    if (auto target = find(who))
+    {
+        uint64_t seq = ChatLog::unjournaled;
+        if (history)
+        {
+            seq = history->journal.append(origin, who, message);
+            if (history->search) history->search->add(seq, message);
+        }
+        target->receive(make_message(origin, message), seq);
+    }
+}
+
+vector<ChatLog::Entry> ChatRoom::search(const User *u, const string &query, size_t limit) const
+{
+    vector<ChatLog::Entry> out;
+    if (!history || !history->search || !u->chat_log.attached_to(&history->journal))
+        return out;
 
-    if (target != end(users))
+    // matches are for the whole room, keep the newest ones this user got
+    auto docs = history->search->query(query);
+    for (auto it = docs.rbegin(); it != docs.rend() && out.size() < limit; ++it)
     {
-        (*target)->receive(origin, message);
+        auto r = history->journal.read(*it);
+        if (u->chat_log.sees(*it, r))
+            out.push_back({ *it, make_message(r.origin, r.text) });
     }
+    reverse(out.begin(), out.end());
+    return out;
 }
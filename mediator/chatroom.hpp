@@ -1,7 +1,14 @@
 #pragma once
 #include <algorithm>
+#include <filesystem>
+#include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
+#include "chatlog.hpp"
+#include "journal.hpp"
+#include "message.hpp"
+#include "search.hpp"
 // #include <user.hpp>
 using namespace std;
 
@@ -10,10 +17,46 @@ struct User;
 struct ChatRoom
 {
     vector<User*> users;
+    // name -> position in `users`, so a user is found without a scan
+    unordered_map<string, size_t> index;
+
+    // set by keep_history: every message goes to the journal and members'
+    // chat logs are rings in the arena, slices[i] is users[i]'s
+    struct History
+    {
+        ChatJournal journal;
+        LogArena arena;
+        vector<ChatLog::Entry*> slices;
+        unique_ptr<SearchIndex> search;    // by journal sequence number
+
+        History(const filesystem::path& file, size_t per_user) : journal(file), arena(per_user) {}
+    };
+    unique_ptr<History> history;
+
+    ChatRoom() = default;
+    ~ChatRoom();
+
+    // Keeps the room's messages in `file` (and `file`.idx) and the last
+    // `per_user` messages of each member in memory, older ones are read back
+    // with ChatLog::scrollback.
+    // `searchable` also indexes every message for search(), including what
+    // the journal already holds from before.
+    void keep_history(const filesystem::path& file, size_t per_user = 256, bool searchable = false);
+
+    // The newest `limit` messages `u` received that match `query` (words that
+    // must all appear, "quoted phrases"), oldest first. Needs a searchable
+    // history.
+    vector<ChatLog::Entry> search(const User* u, const string& query, size_t limit = 20) const;
 
     void broadcast(const string& origin, const string& message);
+    void broadcast(const MessagePtr& message);
+
+    // false if someone with the same name is already in the room,
+    // `announce` = false joins without telling the room (bulk loading)
+    bool join(User* p, bool announce = true);
+    void leave(User* p, bool announce = true);
 
-    void join(User* p);
+    User* find(const string& name) const;
 
     void message(
         const string& origin,
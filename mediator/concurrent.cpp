@@ -0,0 +1,99 @@
+#include "user.hpp"
+#include "concurrentroom.hpp"
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+
+// Senders broadcasting into a ConcurrentChatRoom while reader threads drain
+// the users' inboxes, for growing numbers of workers. Checks that every user
+// gets every sender's messages in order.
+// usage: ./concurrent [users] [broadcasts per sender] [senders] [readers] [max workers]
+int main(int argc, char* argv[])
+{
+    const size_t user_count = argc > 1 ? stoul(argv[1]) : 10'000;
+    const size_t per_sender = argc > 2 ? stoul(argv[2]) : 100;
+    const size_t senders = argc > 3 ? stoul(argv[3]) : 4;
+    const size_t readers = argc > 4 ? stoul(argv[4]) : 4;
+    const size_t max_workers = argc > 5 ? stoul(argv[5]) : max(4u, thread::hardware_concurrency());
+    using clock = chrono::steady_clock;
+
+    vector<unique_ptr<User>> users;
+    for (size_t i = 0; i < user_count; ++i)
+    {
+        users.push_back(make_unique<User>("user" + to_string(i)));
+        users.back()->echo = false;
+    }
+    const size_t expected = senders * per_sender * (user_count - 1);
+
+    cout << user_count << " users, " << senders << " senders x " << per_sender
+         << " broadcasts, " << readers << " readers\n"
+         << fixed << setprecision(2)
+         << "workers   deliveries/s   latency p50 / p99 / p99.9 / max (ms)   order\n";
+    for (size_t worker_count = 1; worker_count <= max_workers; worker_count *= 2)
+    {
+        ConcurrentChatRoom room{ worker_count };
+        vector<ConcurrentChatRoom::Inbox*> inboxes;
+        for (auto& u : users)
+        {
+            room.join(u.get(), false);
+            inboxes.push_back(room.inbox(u.get()));
+        }
+
+        // last sequence number seen by every user from every sender
+        vector<int64_t> last(user_count * senders, -1);
+        atomic<size_t> delivered{ 0 };
+        atomic<bool> in_order{ true };
+        vector<vector<float>> latencies(readers);
+
+        auto start = clock::now();
+        vector<jthread> threads;
+        for (size_t r = 0; r < readers; ++r)
+            threads.emplace_back([&, r] {
+                auto& samples = latencies[r];
+                size_t seen = 0;
+                while (delivered.load(memory_order_relaxed) < expected)
+                {
+                    size_t got = 0;
+                    for (size_t i = r; i < user_count; i += readers)
+                    {
+                        got += ConcurrentChatRoom::drain(*inboxes[i], [&](const Delivery& d) {
+                            const auto& m = *d.message;
+                            size_t s = 0;
+                            int64_t seq = 0;
+                            from_chars(m.origin.data() + 4, m.origin.data() + m.origin.size(), s);
+                            from_chars(m.text.data(), m.text.data() + m.text.size(), seq);
+                            auto& previous = last[i * senders + s];
+                            if (seq != previous + 1) in_order.store(false, memory_order_relaxed);
+                            previous = seq;
+                            if (++seen % 16 == 0)
+                                samples.push_back(chrono::duration<float, milli>(clock::now() - d.sent).count());
+                        });
+                        users[i]->chat_log.clear();
+                    }
+                    if (got) delivered.fetch_add(got, memory_order_relaxed);
+                    else this_thread::yield();
+                }
+            });
+        for (size_t s = 0; s < senders; ++s)
+            threads.emplace_back([&, s] {
+                for (size_t seq = 0; seq < per_sender; ++seq)
+                    room.broadcast(users[s]->name, to_string(seq));
+            });
+        threads.clear();
+        chrono::duration<double> took = clock::now() - start;
+
+        vector<float> all;
+        for (auto& l : latencies) all.insert(all.end(), l.begin(), l.end());
+        sort(all.begin(), all.end());
+        auto pct = [&](double p) { return all.empty() ? 0.0f : all[min(all.size() - 1, size_t(p / 100 * all.size()))]; };
+
+        cout << "  " << worker_count << "\t  " << size_t(expected / took.count()) << "\t "
+             << pct(50) << " / " << pct(99) << " / " << pct(99.9) << " / "
+             << (all.empty() ? 0.0f : all.back()) << "\t"
+             << (in_order ? "ok" : "OUT OF ORDER") << "\n";
+    }
+    return 0;
+}
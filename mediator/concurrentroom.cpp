@@ -0,0 +1,129 @@
+#include "concurrentroom.hpp"
+
+ConcurrentChatRoom::ConcurrentChatRoom(size_t worker_count)
+{
+    worker_count = max<size_t>(worker_count, 1);
+    for (size_t i = 0; i < worker_count; ++i)
+        workers.push_back(make_unique<Worker>());
+    for (auto& w : workers)
+        w->thread = jthread{ [this, &w = *w](stop_token stop) { run(w, stop); } };
+}
+
+ConcurrentChatRoom::~ConcurrentChatRoom()
+{
+    flush();
+    for (auto& w : workers)
+    {
+        w->thread.request_stop();
+        w->signal.fetch_add(1, memory_order_release);
+        w->signal.notify_one();
+    }
+    workers.clear();    // joins
+}
+
+bool ConcurrentChatRoom::join(User *u, bool announce)
+{
+    {
+        lock_guard lock{ index_lock };
+        if (index.count(u->name))
+            return false;
+
+        size_t k = next_worker++ % workers.size();
+        auto& w = *workers[k];
+        lock_guard members{ w.members_lock };
+        auto inbox = make_unique<Inbox>();
+        inbox->user = u;
+        w.members.push_back(inbox.get());
+        index.emplace(u->name, Seat{ move(inbox), k, w.members.size() - 1 });
+    }
+    if (announce)
+        broadcast("room", u->name + " joins the chat");
+    return true;
+}
+
+void ConcurrentChatRoom::leave(User *u)
+{
+    {
+        lock_guard lock{ index_lock };
+        auto it = index.find(u->name);
+        if (it == index.end() || it->second.inbox->user != u)
+            return;
+
+        // same swap with the last member as ChatRoom::leave; once out of
+        // `members` no worker can be pushing into the inbox
+        auto seat = move(it->second);
+        index.erase(it);
+        auto& w = *workers[seat.worker];
+        lock_guard members{ w.members_lock };
+        if (seat.position + 1 != w.members.size())
+        {
+            w.members[seat.position] = w.members.back();
+            index.at(w.members[seat.position]->user->name).position = seat.position;
+        }
+        w.members.pop_back();
+    }
+    broadcast("room", u->name + " leaves the chat");
+}
+
+void ConcurrentChatRoom::broadcast(const string &origin, const string &message)
+{
+    broadcast(make_message(origin, message));
+}
+
+void ConcurrentChatRoom::broadcast(const MessagePtr &message)
+{
+    auto now = clock::now();
+    pending.fetch_add(workers.size(), memory_order_relaxed);
+    for (auto& w : workers)
+    {
+        w->tasks.push({ message, now });
+        w->signal.fetch_add(1, memory_order_release);
+        w->signal.notify_one();
+    }
+}
+
+void ConcurrentChatRoom::message(
+    const string& origin,
+    const string& who,
+    const string& message)
+{
+    lock_guard lock{ index_lock };
+    auto it = index.find(who);
+    if (it != index.end())
+        it->second.inbox->queue.push({ make_message(origin, message), clock::now() });
+}
+
+ConcurrentChatRoom::Inbox* ConcurrentChatRoom::inbox(const User* u)
+{
+    lock_guard lock{ index_lock };
+    auto it = index.find(u->name);
+    return it != index.end() && it->second.inbox->user == u ? it->second.inbox.get() : nullptr;
+}
+
+void ConcurrentChatRoom::flush()
+{
+    for (size_t n; (n = pending.load(memory_order_acquire)) != 0;)
+        pending.wait(n, memory_order_acquire);
+}
+
+void ConcurrentChatRoom::run(Worker &w, stop_token stop)
+{
+    for (;;)
+    {
+        uint32_t seen = w.signal.load(memory_order_acquire);
+        while (auto task = w.tasks.pop())
+        {
+            {
+                lock_guard lock{ w.members_lock };
+                for (auto inbox : w.members)
+                    if (inbox->user->name != task->message->origin)
+                        inbox->queue.push({ task->message, task->sent });
+            }
+            if (pending.fetch_sub(1, memory_order_acq_rel) == 1)
+                pending.notify_all();
+        }
+        if (stop.stop_requested() && w.tasks.empty())
+            return;
+        w.signal.wait(seen, memory_order_acquire);
+    }
+}
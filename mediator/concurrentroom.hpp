@@ -0,0 +1,128 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "message.hpp"
+#include "mpscqueue.hpp"
+#include "user.hpp"
+using namespace std;
+
+// a message waiting in an inbox, with when it was sent for latency
+struct Delivery
+{
+    MessagePtr message;
+    chrono::steady_clock::time_point sent;
+};
+
+// A chat room that can be used from many threads at once.
+//
+// broadcast() doesn't deliver anything itself: it queues the message once per
+// worker and returns. Every member belongs to one worker (round robin at
+// join), each worker pushes the message into the inbox of its own members, and
+// users pick their messages up with drain() on their own thread. The inboxes
+// belong to the room, a User stays the same plain colleague it is in a
+// ChatRoom.
+//
+// Ordering: a user is always served by the same worker, and a worker handles
+// its queue in order, so messages broadcast one after the other (e.g. by the
+// same sender) reach every user in that order. pm's go straight to the
+// target's inbox and aren't ordered with respect to broadcasts.
+class ConcurrentChatRoom
+{
+public:
+    // Filled by the workers from any thread, emptied on the member's own
+    // thread. Lives from join() to leave().
+    struct alignas(64) Inbox
+    {
+        User* user;
+        MpscQueue<Delivery> queue;
+    };
+
+private:
+    using clock = chrono::steady_clock;
+
+    struct Task
+    {
+        MessagePtr message;
+        clock::time_point sent;
+    };
+
+    struct alignas(64) Worker
+    {
+        MpscQueue<Task> tasks;
+        atomic<uint32_t> signal{ 0 };      // bumped on every push, waited on when idle
+        mutex members_lock;
+        vector<Inbox*> members;
+        jthread thread;
+    };
+
+    vector<unique_ptr<Worker>> workers;
+
+    struct Seat
+    {
+        unique_ptr<Inbox> inbox;
+        size_t worker;
+        size_t position;                   // in workers[worker]->members
+    };
+    mutex index_lock;
+    unordered_map<string, Seat> index;
+    size_t next_worker = 0;
+
+    atomic<size_t> pending{ 0 };           // queued broadcast tasks not delivered yet
+    atomic<bool> stopping{ false };
+
+public:
+    explicit ConcurrentChatRoom(size_t worker_count = thread::hardware_concurrency());
+    // delivers whatever is still queued, then stops the workers
+    ~ConcurrentChatRoom();
+
+    ConcurrentChatRoom(const ConcurrentChatRoom&) = delete;
+    ConcurrentChatRoom& operator=(const ConcurrentChatRoom&) = delete;
+
+    // same rules as ChatRoom::join
+    bool join(User* p, bool announce = true);
+    void leave(User* p);
+
+    void broadcast(const string& origin, const string& message);
+    void broadcast(const MessagePtr& message);
+    void message(const string& origin, const string& who, const string& message);
+
+    // waits until every broadcast made so far is in its recipients' inboxes
+    void flush();
+
+    // the member's inbox, nullptr if `u` isn't one; not valid after leave()
+    Inbox* inbox(const User* u);
+
+    // receives everything in the inbox, oldest first, calling
+    // `on_delivery(const Delivery&)` for each; returns how many
+    template <typename OnDelivery>
+    static size_t drain(Inbox& inbox, OnDelivery&& on_delivery)
+    {
+        size_t n = 0;
+        while (auto d = inbox.queue.pop())
+        {
+            on_delivery(*d);
+            inbox.user->receive(d->message);
+            ++n;
+        }
+        return n;
+    }
+    static size_t drain(Inbox& inbox) { return drain(inbox, [](const Delivery&) {}); }
+
+    // looks the inbox up first, 0 if `u` isn't a member
+    size_t drain(const User* u)
+    {
+        auto in = inbox(u);
+        return in ? drain(*in) : 0;
+    }
+
+    size_t worker_count() const { return workers.size(); }
+
+private:
+    void run(Worker& w, stop_token stop);
+};
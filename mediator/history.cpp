@@ -0,0 +1,107 @@
+#include "user.hpp"
+#include "chatroom.hpp"
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <unistd.h>
+#include <malloc.h>
+
+static size_t heap_bytes()
+{
+    auto info = mallinfo2();
+    return info.uordblks + info.hblkhd;    // big blocks are mmapped
+}
+
+// A busy room that keeps history: members hold only their last `per_user`
+// messages, everything else is in the room's journal on disk. Scrolls one
+// user all the way back and checks it against a full copy of their log.
+// usage: ./history [users] [messages] [per user]
+int main(int argc, char* argv[])
+{
+    const size_t user_count = argc > 1 ? stoul(argv[1]) : 1000;
+    const size_t messages = argc > 2 ? stoul(argv[2]) : 200'000;
+    const size_t per_user = argc > 3 ? stoul(argv[3]) : 64;
+    using clock = chrono::steady_clock;
+
+    auto file = filesystem::temp_directory_path() / ("chatroom-" + to_string(getpid()) + ".log");
+    size_t before = heap_bytes();
+    // what an unbounded chat_log of user0 would hold: (sender, message number)
+    vector<pair<uint32_t, uint32_t>> full_log;
+    chrono::duration<double> sending;
+    {
+        vector<unique_ptr<User>> users;    // outlive the room
+        ChatRoom room;
+        room.keep_history(file, per_user);
+        for (size_t i = 0; i < user_count; ++i)
+        {
+            users.push_back(make_unique<User>("user" + to_string(i)));
+            users.back()->echo = false;
+            room.join(users.back().get(), false);
+        }
+
+        mt19937 rng{ 7 };
+        uniform_int_distribution<size_t> pick{ 0, user_count - 1 }, percent{ 0, 99 };
+        auto start = clock::now();
+        for (size_t m = 0; m < messages; ++m)
+        {
+            size_t from_index = pick(rng);
+            auto& from = *users[from_index];
+            string text = "message " + to_string(m);
+            if (percent(rng) < 10)
+            {
+                // a pm, to user0 often enough to show up in its scrollback
+                string to = percent(rng) < 50 ? "user0" : users[pick(rng)]->name;
+                if (to == from.name) continue;
+                from.pm(to, text);
+                if (to == "user0") full_log.emplace_back(from_index, m);
+            }
+            else
+            {
+                from.say(text);
+                if (from_index != 0) full_log.emplace_back(from_index, m);
+            }
+        }
+        sending = clock::now() - start;
+        size_t used = heap_bytes() - before - full_log.capacity() * sizeof(full_log[0]);
+
+        // scroll user0 back to the beginning, a page at a time
+        auto& log = users[0]->chat_log;
+        vector<string> seen;
+        for (size_t i = 0; i < log.size(); ++i)
+            seen.push_back(log[i]->format());
+        const size_t page = 50;
+        size_t pages = 0;
+        start = clock::now();
+        uint64_t before_seq = ChatLog::unjournaled;
+        for (;;)
+        {
+            auto older = log.scrollback(page, before_seq);
+            if (older.empty()) break;
+            ++pages;
+            before_seq = older.front().seq;
+            vector<string> formatted;
+            for (auto& e : older) formatted.push_back(e.message->format());
+            seen.insert(seen.begin(), formatted.begin(), formatted.end());
+        }
+        chrono::duration<double, micro> scrolling = clock::now() - start;
+
+        vector<string> expected;
+        for (auto [from, m] : full_log)
+            expected.push_back("user" + to_string(from) + ": \"message " + to_string(m) + "\"");
+        size_t unbounded = full_log.size() * user_count * sizeof(MessagePtr);
+        cout << user_count << " users, " << messages << " messages, " << per_user << " kept per user\n"
+             << "  " << sending.count() * 1e9 / messages << " ns/message\n"
+             << "  heap: " << used / double(1 << 20) << " MB (unbounded logs: about "
+             << unbounded / (1 << 20) << " MB of pointers alone)\n"
+             << "  journal: " << filesystem::file_size(file) / (1 << 20) << " MB on disk\n"
+             << "  scrollback: " << pages << " pages of " << page << ", "
+             << (pages ? scrolling.count() / pages : 0) << " us/page\n"
+             << "  user0's history " << (seen == expected ? "matches" : "MISMATCH")
+             << " (" << full_log.size() << " messages)\n";
+    }
+    filesystem::remove(file);
+    filesystem::remove(file.string() + ".idx");
+    return 0;
+}
@@ -0,0 +1,176 @@
+#pragma once
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <system_error>
+#include <vector>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+using namespace std;
+
+// Append-only history of a room on disk, every message once.
+//
+//   <file>       records: origin, recipient (empty for a broadcast), text,
+//                each a 4 byte length and the bytes
+//   <file>.idx   offset of record n at n * 8
+//
+// Message n is found with one read of the index and one of the record, so
+// history is read back lazily, never loaded as a whole. Appends are collected
+// in memory and written in large pieces; reads of what isn't written yet are
+// served from there. Reopening the same file continues its history.
+class ChatJournal
+{
+public:
+    struct Record
+    {
+        string origin;
+        string to;
+        string text;
+    };
+
+private:
+    filesystem::path data_path, index_path;
+    int data_fd = -1, index_fd = -1;
+    uint64_t flushed_records = 0;      // records [0, flushed_records) are on disk
+    uint64_t flushed_bytes = 0;
+    vector<char> pending_data;
+    vector<uint64_t> pending_index;    // offsets of the records not written yet
+
+    static constexpr size_t flush_at = 64 << 10;
+
+public:
+    explicit ChatJournal(filesystem::path file)
+        : data_path(move(file)), index_path(data_path.string() + ".idx")
+    {
+        data_fd = open(data_path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0600);
+        if (data_fd < 0) fail("open " + data_path.string());
+        index_fd = open(index_path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0600);
+        if (index_fd < 0) fail("open " + index_path.string());
+
+        struct stat index_st, data_st;
+        if (fstat(index_fd, &index_st) < 0 || fstat(data_fd, &data_st) < 0)
+        {
+            int error = errno;
+            close(data_fd);
+            close(index_fd);
+            errno = error;
+            fail("stat " + data_path.string());
+        }
+        flushed_records = index_st.st_size / sizeof(uint64_t);
+        flushed_bytes = data_st.st_size;
+    }
+
+    ChatJournal(const ChatJournal&) = delete;
+    ChatJournal& operator=(const ChatJournal&) = delete;
+
+    // a destructor can't throw: a failed last flush is reported and lost
+    ~ChatJournal()
+    {
+        try
+        {
+            if (data_fd >= 0 && index_fd >= 0) flush();
+        }
+        catch (const exception& e)
+        {
+            cerr << "chat journal: " << e.what() << "\n";
+        }
+        if (data_fd >= 0) close(data_fd);
+        if (index_fd >= 0) close(index_fd);
+    }
+
+    // returns the message's sequence number
+    uint64_t append(const string& origin, const string& to, const string& text)
+    {
+        pending_index.push_back(flushed_bytes + pending_data.size());
+        for (auto s : { &origin, &to, &text })
+        {
+            uint32_t n = static_cast<uint32_t>(s->size());
+            auto p = reinterpret_cast<const char*>(&n);
+            pending_data.insert(pending_data.end(), p, p + sizeof n);
+            pending_data.insert(pending_data.end(), s->begin(), s->end());
+        }
+        uint64_t seq = flushed_records + pending_index.size() - 1;
+        if (pending_data.size() >= flush_at) flush();
+        return seq;
+    }
+
+    Record read(uint64_t seq) const
+    {
+        uint64_t begin, end;
+        const char* p;
+        string disk;
+        if (seq >= flushed_records)
+        {
+            size_t i = seq - flushed_records;
+            begin = pending_index[i] - flushed_bytes;
+            end = i + 1 < pending_index.size() ? pending_index[i + 1] - flushed_bytes : pending_data.size();
+            p = pending_data.data() + begin;
+        }
+        else
+        {
+            uint64_t offsets[2];
+            size_t want = seq + 1 < flushed_records ? 2 : 1;
+            read_exactly(index_fd, offsets, want * sizeof(uint64_t), seq * sizeof(uint64_t), index_path);
+            begin = offsets[0];
+            end = want == 2 ? offsets[1] : flushed_bytes;
+            disk.resize(end - begin);
+            read_exactly(data_fd, disk.data(), disk.size(), begin, data_path);
+            p = disk.data();
+        }
+
+        Record r;
+        for (auto s : { &r.origin, &r.to, &r.text })
+        {
+            uint32_t n;
+            memcpy(&n, p, sizeof n);
+            s->assign(p + sizeof n, n);
+            p += sizeof n + n;
+        }
+        return r;
+    }
+
+    uint64_t size() const { return flushed_records + pending_index.size(); }
+
+    void flush()
+    {
+        if (pending_index.empty()) return;
+        write_all(data_fd, pending_data.data(), pending_data.size(), data_path);
+        write_all(index_fd, pending_index.data(), pending_index.size() * sizeof(uint64_t), index_path);
+        flushed_bytes += pending_data.size();
+        flushed_records += pending_index.size();
+        pending_data.clear();
+        pending_index.clear();
+    }
+
+private:
+    [[noreturn]] static void fail(const string& what)
+    {
+        throw system_error(errno, generic_category(), what);
+    }
+
+    static void write_all(int fd, const void* data, size_t n, const filesystem::path& path)
+    {
+        auto p = static_cast<const char*>(data);
+        while (n > 0)
+        {
+            ssize_t w = write(fd, p, n);
+            if (w < 0)
+            {
+                if (errno == EINTR) continue;
+                fail("write " + path.string());
+            }
+            p += w;
+            n -= w;
+        }
+    }
+
+    static void read_exactly(int fd, void* into, size_t n, uint64_t offset, const filesystem::path& path)
+    {
+        if (pread(fd, into, n, offset) != ssize_t(n))
+            fail("read " + path.string());
+    }
+};
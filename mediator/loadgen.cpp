@@ -0,0 +1,205 @@
+#include "protocol.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Load generator for ./server: opens many connections, each says HELLO as
+// load<i>, then random connections SAY the current time at a steady rate.
+// Every MSG read is a delivery; its text gives the send-to-receive latency
+// (the monotonic clock is the same for every process on the box).
+//
+// Over TCP each source address only has ~28k ephemeral ports towards one
+// server port, so connections are spread over 127.0.0.2, 127.0.0.3, ...
+// Unix sockets have no such limit.
+//
+// usage: ./loadgen [--port N | --unix PATH] [--connections N] [--rate SAYs/s] [--seconds S]
+
+namespace
+{
+    using clock = chrono::steady_clock;
+
+    struct Client
+    {
+        int fd;
+        string partial;
+    };
+
+    [[noreturn]] void die(const string& what)
+    {
+        cerr << what << ": " << strerror(errno) << "\n";
+        exit(1);
+    }
+
+    int64_t now_ns()
+    {
+        return chrono::duration_cast<chrono::nanoseconds>(clock::now().time_since_epoch()).count();
+    }
+
+    int connect_to(uint16_t port, const string& unix_path, size_t i)
+    {
+        if (!unix_path.empty())
+        {
+            int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+            sockaddr_un addr{};
+            addr.sun_family = AF_UNIX;
+            strncpy(addr.sun_path, unix_path.c_str(), sizeof addr.sun_path - 1);
+            if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof addr) < 0) die("connect " + unix_path);
+            return fd;
+        }
+
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        int one = 1;
+        setsockopt(fd, IPPROTO_IP, IP_BIND_ADDRESS_NO_PORT, &one, sizeof one);
+        sockaddr_in from{};
+        from.sin_family = AF_INET;
+        from.sin_addr.s_addr = htonl(0x7F000002 + static_cast<uint32_t>(i / 25'000));
+        if (bind(fd, reinterpret_cast<sockaddr*>(&from), sizeof from) < 0) die("bind");
+        sockaddr_in to{};
+        to.sin_family = AF_INET;
+        to.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        to.sin_port = htons(port);
+        if (connect(fd, reinterpret_cast<sockaddr*>(&to), sizeof to) < 0) die("connect");
+        return fd;
+    }
+
+    void send_all(int fd, const vector<char>& frame)
+    {
+        size_t sent = 0;
+        while (sent < frame.size())
+        {
+            ssize_t n = write(fd, frame.data() + sent, frame.size() - sent);
+            if (n < 0)
+            {
+                if (errno == EINTR || errno == EAGAIN) continue;
+                die("write");
+            }
+            sent += n;
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    uint16_t port = 9000;
+    string unix_path;
+    size_t connection_count = 10'000;
+    double rate = 20, seconds = 10;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        string flag = argv[i];
+        if (flag == "--port") port = static_cast<uint16_t>(stoul(argv[i + 1]));
+        else if (flag == "--unix") unix_path = argv[i + 1];
+        else if (flag == "--connections") connection_count = stoul(argv[i + 1]);
+        else if (flag == "--rate") rate = stod(argv[i + 1]);
+        else if (flag == "--seconds") seconds = stod(argv[i + 1]);
+    }
+    signal(SIGPIPE, SIG_IGN);
+    auto fd_limit = protocol::raise_fd_limit();
+    if (connection_count + 16 > fd_limit)
+    {
+        connection_count = fd_limit - 16;
+        cerr << "file descriptor limit " << fd_limit << ", using " << connection_count << " connections\n";
+    }
+
+    int epoll_fd = epoll_create1(0);
+    vector<Client> clients(connection_count);
+    vector<char> frame;
+    auto start = clock::now();
+    for (size_t i = 0; i < connection_count; ++i)
+    {
+        int fd = connect_to(port, unix_path, i);
+        frame.clear();
+        protocol::append_frame(frame, protocol::hello, "load" + to_string(i));
+        send_all(fd, frame);
+
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        clients[i].fd = fd;
+        epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLET;
+        ev.data.u64 = i;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+    }
+    chrono::duration<double> connecting = clock::now() - start;
+    cout << connection_count << " connections in " << connecting.count() << "s" << endl;
+    // HELLOs are not acknowledged, give the server a moment to join everyone
+    this_thread::sleep_for(chrono::milliseconds(500));
+
+    mt19937 rng{ 11 };
+    uniform_int_distribution<size_t> pick{ 0, connection_count - 1 };
+    vector<float> latencies;        // us, every 64th delivery
+    uint64_t delivered = 0, said = 0;
+    static char buffer[256 << 10];
+    vector<epoll_event> events(4096);
+
+    start = clock::now();
+    auto end = start + chrono::duration_cast<clock::duration>(chrono::duration<double>(seconds));
+    // keep reading for a moment after the last SAY
+    auto drain_end = end + chrono::seconds(2);
+    const auto interval = chrono::duration<double>(1.0 / max(rate, 1e-3));
+    auto next_say = start;
+    while (clock::now() < drain_end)
+    {
+        auto now = clock::now();
+        while (now < end && next_say <= now)
+        {
+            frame.clear();
+            protocol::append_frame(frame, protocol::say, to_string(now_ns()));
+            send_all(clients[pick(rng)].fd, frame);
+            ++said;
+            next_say += chrono::duration_cast<clock::duration>(interval);
+        }
+
+        int n = epoll_wait(epoll_fd, events.data(), static_cast<int>(events.size()), 1);
+        for (int e = 0; e < n; ++e)
+        {
+            auto& c = clients[events[e].data.u64];
+            for (;;)
+            {
+                size_t have = c.partial.size();
+                memcpy(buffer, c.partial.data(), have);
+                ssize_t got = read(c.fd, buffer + have, sizeof buffer - have);
+                if (got <= 0) break;
+                size_t total = have + got;
+                int64_t received = now_ns();
+                size_t used = protocol::parse(buffer, total, [&](protocol::Type type, string_view payload) {
+                    string_view origin, text;
+                    if (type != protocol::msg || !protocol::split_addressed(payload, origin, text)) return;
+                    if (++delivered % 64) return;
+                    int64_t sent = 0;
+                    if (from_chars(text.data(), text.data() + text.size(), sent).ec == errc{})
+                        latencies.push_back((received - sent) / 1000.0f);
+                });
+                if (used == SIZE_MAX) die("bad frame from server");
+                c.partial.assign(buffer + used, total - used);
+            }
+        }
+    }
+    chrono::duration<double> took = clock::now() - start;
+
+    sort(latencies.begin(), latencies.end());
+    auto pct = [&](double p) {
+        return latencies.empty() ? 0.0f : latencies[min(latencies.size() - 1, size_t(p / 100 * latencies.size()))];
+    };
+    uint64_t expected = said * (connection_count - 1);
+    cout << said << " SAYs to " << connection_count << " connections, " << delivered << " of "
+         << expected << " deliveries (" << delivered / took.count() << "/s)\n"
+         << "latency us: p50 " << pct(50) << ", p99 " << pct(99) << ", p99.9 " << pct(99.9)
+         << ", max " << (latencies.empty() ? 0.0f : latencies.back()) << "\n";
+
+    for (auto& c : clients) close(c.fd);
+    return 0;
+}
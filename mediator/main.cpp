@@ -18,5 +18,8 @@ int main()
 
     jane.pm("Simon", "glad you found us, simon!");
 
+    room.leave(&john);
+    simon.pm("John", "are you still there?");   // nobody to deliver to
+
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,31 @@
+#pragma once
+#include <memory>
+#include <ostream>
+#include <string>
+using namespace std;
+
+// One message as sent, never changed afterwards. A broadcast creates it once
+// and every recipient's chat_log holds a reference to the same object.
+// Turning it into text is left until it is displayed.
+struct ChatMessage
+{
+    string origin;
+    string text;
+
+    string format() const
+    {
+        return origin + ": \"" + text + "\"";
+    }
+
+    friend ostream& operator<<(ostream& os, const ChatMessage& m)
+    {
+        return os << m.origin << ": \"" << m.text << "\"";
+    }
+};
+
+using MessagePtr = shared_ptr<const ChatMessage>;
+
+inline MessagePtr make_message(const string& origin, const string& text)
+{
+    return make_shared<const ChatMessage>(ChatMessage{ origin, text });
+}
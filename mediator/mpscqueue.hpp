@@ -0,0 +1,59 @@
+#pragma once
+#include <atomic>
+#include <optional>
+#include <utility>
+using namespace std;
+
+// Unbounded multi producer / single consumer queue (Vyukov's). A push is one
+// atomic exchange on `head` and a store, never a loop, so producers don't
+// wait for each other or for the consumer. Only the consumer touches `tail`.
+//
+// Between a producer's exchange and its store the new node isn't linked yet,
+// pop() reports empty for that moment: the item shows up on a later pop.
+template <typename T>
+class MpscQueue
+{
+    struct Node
+    {
+        atomic<Node*> next{ nullptr };
+        T value;
+    };
+
+    alignas(64) atomic<Node*> head;    // newest, written by producers
+    alignas(64) Node* tail;            // oldest, already consumed (a stub)
+    Node stub;
+
+public:
+    MpscQueue() : head(&stub), tail(&stub) {}
+
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    ~MpscQueue()
+    {
+        while (pop()) {}
+        if (tail != &stub) delete tail;
+    }
+
+    void push(T value)
+    {
+        auto n = new Node{ nullptr, move(value) };
+        Node* previous = head.exchange(n, memory_order_acq_rel);
+        previous->next.store(n, memory_order_release);
+    }
+
+    optional<T> pop()
+    {
+        Node* t = tail;
+        Node* next = t->next.load(memory_order_acquire);
+        if (!next) return {};
+        // `next` becomes the stub, its value moves out
+        optional<T> value{ move(next->value) };
+        tail = next;
+        if (t != &stub) delete t;
+        return value;
+    }
+
+    // only meaningful on the consumer's thread
+    bool empty() const { return tail->next.load(memory_order_acquire) == nullptr; }
+};
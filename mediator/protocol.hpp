@@ -0,0 +1,115 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <arpa/inet.h>
+#include <sys/resource.h>
+using namespace std;
+
+// Wire format of the chat server: frames of
+//   u32 length (big endian, of what follows), u8 type, payload
+//
+//   HELLO  client -> server  name; joins the room as that user
+//   SAY    client -> server  text; ChatRoom::broadcast
+//   PM     client -> server  u16 name length, name, text; ChatRoom::message
+//   MSG    server -> client  u16 origin length, origin, text
+namespace protocol
+{
+    enum Type : uint8_t { hello = 1, say = 2, pm = 3, msg = 4 };
+
+    constexpr size_t header_size = 5;                 // length + type
+    constexpr size_t msg_header_size = header_size + 2;
+    constexpr size_t max_frame = 64 << 10;
+
+    inline void put_u32(char* p, uint32_t v)
+    {
+        v = htonl(v);
+        memcpy(p, &v, 4);
+    }
+
+    inline uint32_t get_u32(const char* p)
+    {
+        uint32_t v;
+        memcpy(&v, p, 4);
+        return ntohl(v);
+    }
+
+    inline void put_u16(char* p, uint16_t v)
+    {
+        v = htons(v);
+        memcpy(p, &v, 2);
+    }
+
+    inline uint16_t get_u16(const char* p)
+    {
+        uint16_t v;
+        memcpy(&v, p, 2);
+        return ntohs(v);
+    }
+
+    // a whole frame with a plain payload (HELLO, SAY)
+    inline void append_frame(vector<char>& out, Type type, string_view payload)
+    {
+        size_t at = out.size();
+        out.resize(at + header_size);
+        put_u32(&out[at], static_cast<uint32_t>(1 + payload.size()));
+        out[at + 4] = static_cast<char>(type);
+        out.insert(out.end(), payload.begin(), payload.end());
+    }
+
+    // a PM frame, or with type msg a MSG frame (same layout)
+    inline void append_addressed(vector<char>& out, Type type, string_view name, string_view text)
+    {
+        size_t at = out.size();
+        out.resize(at + msg_header_size);
+        put_u32(&out[at], static_cast<uint32_t>(3 + name.size() + text.size()));
+        out[at + 4] = static_cast<char>(type);
+        put_u16(&out[at + 5], static_cast<uint16_t>(name.size()));
+        out.insert(out.end(), name.begin(), name.end());
+        out.insert(out.end(), text.begin(), text.end());
+    }
+
+    // splits an addressed payload, false if it is malformed
+    inline bool split_addressed(string_view payload, string_view& name, string_view& text)
+    {
+        if (payload.size() < 2) return false;
+        size_t n = get_u16(payload.data());
+        if (payload.size() < 2 + n) return false;
+        name = payload.substr(2, n);
+        text = payload.substr(2 + n);
+        return true;
+    }
+
+    // Calls on_frame(type, payload) for every complete frame in [data, data + n)
+    // and returns how many bytes that used, or SIZE_MAX on a bad frame.
+    template <typename OnFrame>
+    size_t parse(const char* data, size_t n, OnFrame&& on_frame)
+    {
+        size_t used = 0;
+        while (n - used >= header_size)
+        {
+            uint32_t length = get_u32(data + used);
+            if (length == 0 || length > max_frame) return SIZE_MAX;
+            if (n - used < 4 + length) break;
+            on_frame(static_cast<Type>(data[used + 4]), string_view{ data + used + header_size, length - 1 });
+            used += 4 + length;
+        }
+        return used;
+    }
+
+    // lifts the open file limit as far as allowed, returns the new limit
+    inline rlim_t raise_fd_limit()
+    {
+        rlimit limit;
+        getrlimit(RLIMIT_NOFILE, &limit);
+        for (rlim_t want : { rlim_t(1 << 20), limit.rlim_max })
+        {
+            rlimit raised{ want, max(want, limit.rlim_max) };
+            if (setrlimit(RLIMIT_NOFILE, &raised) == 0) return want;
+        }
+        return limit.rlim_cur;
+    }
+}
@@ -0,0 +1,108 @@
+#include "registry.hpp"
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <malloc.h>
+
+static size_t heap_bytes()
+{
+    auto info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+}
+
+// Millions of rooms, every user in many of them: most rooms are small, a few
+// popular ones have hundreds of members (and switch to hash sets).
+// usage: ./registry [rooms] [users] [rooms per user] [publishes]
+int main(int argc, char* argv[])
+{
+    const size_t room_count = argc > 1 ? stoul(argv[1]) : 2'000'000;
+    const size_t user_count = argc > 2 ? stoul(argv[2]) : 200'000;
+    const size_t per_user = argc > 3 ? stoul(argv[3]) : 20;
+    const size_t publishes = argc > 4 ? stoul(argv[4]) : 100'000;
+    const size_t popular = 1000, topic_count = 100'000;
+    using clock = chrono::steady_clock;
+
+    vector<unique_ptr<User>> people;
+    for (size_t i = 0; i < user_count; ++i)
+    {
+        people.push_back(make_unique<User>("user" + to_string(i)));
+        people.back()->echo = false;
+    }
+
+    size_t before = heap_bytes();
+    RoomRegistry registry;
+    auto start = clock::now();
+    registry.reserve(room_count + topic_count);
+    for (size_t r = 0; r < room_count; ++r)
+        registry.create_room();
+    for (size_t t = 0; t < topic_count; ++t)
+        registry.room("topic" + to_string(t));     // named rooms, after the numbered ones
+    chrono::duration<double, nano> creating = clock::now() - start;
+    size_t empty_rooms = heap_bytes() - before;
+
+    for (auto& p : people) registry.add_user(p.get());
+
+    mt19937 rng{ 3 };
+    uniform_int_distribution<RoomId> any_room{ 0, RoomId(room_count - 1) }, hot{ 0, RoomId(popular - 1) };
+    uniform_int_distribution<int> percent{ 0, 99 };
+    vector<pair<UserId, RoomId>> joined;
+    before = heap_bytes();
+    start = clock::now();
+    for (UserId u = 0; u < user_count; ++u)
+        for (size_t k = 0; k < per_user; ++k)
+        {
+            RoomId r = percent(rng) < 10 ? hot(rng) : any_room(rng);
+            if (registry.join(u, r)) joined.emplace_back(u, r);
+        }
+    chrono::duration<double, nano> joining = clock::now() - start;
+    size_t membership_bytes = heap_bytes() - before - joined.capacity() * sizeof(joined[0]);
+
+    size_t large = 0, biggest = 0;
+    for (RoomId r = 0; r < registry.room_count(); ++r)
+    {
+        large += registry.members(r).size() > 32;
+        biggest = max(biggest, registry.members(r).size());
+    }
+
+    // a user posts to one of their rooms
+    uniform_int_distribution<size_t> pick{ 0, joined.size() - 1 };
+    size_t delivered = 0;
+    start = clock::now();
+    for (size_t i = 0; i < publishes; ++i)
+    {
+        auto [u, r] = joined[pick(rng)];
+        delivered += registry.publish(r, u, "hello");
+    }
+    chrono::duration<double, nano> publishing = clock::now() - start;
+
+    // by topic name: nobody joined those rooms, so this times the lookup
+    // and the membership check
+    uniform_int_distribution<size_t> any_topic{ 0, topic_count - 1 };
+    vector<string> topic_names(publishes);
+    for (auto& t : topic_names) t = "topic" + to_string(any_topic(rng));
+    start = clock::now();
+    for (size_t i = 0; i < publishes; ++i)
+        registry.publish(topic_names[i], 0, "hi");
+    chrono::duration<double, nano> by_topic = clock::now() - start;
+
+    const size_t leaving = min<size_t>(user_count, 10'000);
+    start = clock::now();
+    for (UserId u = 0; u < leaving; ++u)
+        registry.leave_all(u);
+    chrono::duration<double, nano> leaving_all = clock::now() - start;
+
+    cout << room_count + topic_count << " rooms, " << user_count << " users, "
+         << joined.size() << " memberships\n"
+         << "  empty room:  " << double(empty_rooms) / registry.room_count() << " bytes, "
+         << creating.count() / registry.room_count() << " ns to create\n"
+         << "  membership:  " << double(membership_bytes) / joined.size() << " bytes (both directions), "
+         << joining.count() / (user_count * per_user) << " ns/join\n"
+         << "  " << large << " rooms over 32 members (hash sets), biggest " << biggest << "\n"
+         << "  publish:     " << publishing.count() / publishes << " ns, "
+         << publishing.count() / max<size_t>(delivered, 1) << " ns/delivery ("
+         << double(delivered) / publishes << " recipients on average)\n"
+         << "  by topic:    " << by_topic.count() / publishes << " ns/publish\n"
+         << "  leave_all:   " << leaving_all.count() / leaving << " ns/user\n";
+    return 0;
+}
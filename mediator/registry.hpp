@@ -0,0 +1,189 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "message.hpp"
+#include "user.hpp"
+using namespace std;
+
+using RoomId = uint32_t;
+using UserId = uint32_t;
+
+// A set of ids that stays small while it is small: a sorted vector up to
+// `small_limit` ids (a binary search, one allocation), a hash set above that.
+// Goes back to the vector once it has shrunk to half the limit, so a set
+// hovering around the limit doesn't switch on every change. An empty set is
+// 32 bytes and allocates nothing.
+class MemberSet
+{
+    static constexpr size_t small_limit = 32;
+
+    vector<uint32_t> small;
+    unique_ptr<unordered_set<uint32_t>> large;
+
+public:
+    bool insert(uint32_t id)
+    {
+        if (large) return large->insert(id).second;
+        auto it = lower_bound(small.begin(), small.end(), id);
+        if (it != small.end() && *it == id) return false;
+        if (small.size() < small_limit)
+        {
+            small.insert(it, id);
+            return true;
+        }
+        large = make_unique<unordered_set<uint32_t>>(small.begin(), small.end());
+        large->insert(id);
+        small = {};
+        return true;
+    }
+
+    bool erase(uint32_t id)
+    {
+        if (large)
+        {
+            if (!large->erase(id)) return false;
+            if (large->size() <= small_limit / 2)
+            {
+                small.assign(large->begin(), large->end());
+                sort(small.begin(), small.end());
+                large.reset();
+            }
+            return true;
+        }
+        auto it = lower_bound(small.begin(), small.end(), id);
+        if (it == small.end() || *it != id) return false;
+        small.erase(it);
+        if (small.empty()) small = {};
+        return true;
+    }
+
+    bool contains(uint32_t id) const
+    {
+        if (large) return large->count(id) != 0;
+        return binary_search(small.begin(), small.end(), id);
+    }
+
+    size_t size() const { return large ? large->size() : small.size(); }
+    bool empty() const { return size() == 0; }
+
+    template <typename F>
+    void for_each(F&& f) const
+    {
+        if (large)
+            for (auto id : *large) f(id);
+        else
+            for (auto id : small) f(id);
+    }
+};
+
+// Rooms and their members for a whole server: millions of rooms, users in
+// many of them.
+//
+// Rooms are ids into a dense vector, so a message to a room is an index plus
+// a walk over that room's members and never looks at any other room. A room
+// is only its MemberSet (32 bytes while empty). Rooms can also be named by
+// topic, publishing to a topic looks the name up once.
+//
+// Each user's rooms are a MemberSet too, so leaving everything is a walk over
+// their own rooms.
+class RoomRegistry
+{
+    vector<MemberSet> rooms;            // by RoomId
+    vector<User*> users;                // by UserId
+    vector<MemberSet> memberships;      // rooms of each user
+    unordered_map<string, RoomId> topics;
+
+public:
+    // avoids the growing vector's spare capacity when the count is known
+    void reserve(size_t room_count) { rooms.reserve(room_count); }
+
+    RoomId create_room()
+    {
+        rooms.emplace_back();
+        return static_cast<RoomId>(rooms.size() - 1);
+    }
+
+    // the room of `topic`, created on first use
+    RoomId room(const string& topic)
+    {
+        auto [it, added] = topics.try_emplace(topic, 0);
+        if (added) it->second = create_room();
+        return it->second;
+    }
+
+    optional<RoomId> find_topic(const string& topic) const
+    {
+        auto it = topics.find(topic);
+        if (it == topics.end()) return {};
+        return it->second;
+    }
+
+    UserId add_user(User* u)
+    {
+        users.push_back(u);
+        memberships.emplace_back();
+        return static_cast<UserId>(users.size() - 1);
+    }
+
+    // unknown ids are ignored: false, 0 or nothing done, like a name that
+    // isn't in a ChatRoom
+    bool join(UserId user, RoomId room)
+    {
+        if (!known(user, room) || !rooms[room].insert(user)) return false;
+        memberships[user].insert(room);
+        return true;
+    }
+
+    bool leave(UserId user, RoomId room)
+    {
+        if (!known(user, room) || !rooms[room].erase(user)) return false;
+        memberships[user].erase(room);
+        return true;
+    }
+
+    void leave_all(UserId user)
+    {
+        if (user >= users.size()) return;
+        memberships[user].for_each([&](RoomId room) { rooms[room].erase(user); });
+        memberships[user] = {};
+    }
+
+    // one shared message to every member of `room` but the sender,
+    // returns how many got it; 0 if the sender isn't a member
+    size_t publish(RoomId room, UserId from, const string& text)
+    {
+        if (!known(from, room) || !rooms[room].contains(from)) return 0;
+        auto message = make_message(users[from]->name, text);
+        size_t delivered = 0;
+        rooms[room].for_each([&](UserId member) {
+            if (member == from) return;
+            users[member]->receive(message);
+            ++delivered;
+        });
+        return delivered;
+    }
+
+    size_t publish(const string& topic, UserId from, const string& text)
+    {
+        auto room = find_topic(topic);
+        return room ? publish(*room, from, text) : 0;
+    }
+
+    // these throw out_of_range for an unknown id
+    const MemberSet& members(RoomId room) const { return rooms.at(room); }
+    const MemberSet& rooms_of(UserId user) const { return memberships.at(user); }
+    size_t room_count() const { return rooms.size(); }
+    size_t user_count() const { return users.size(); }
+
+private:
+    bool known(UserId user, RoomId room) const
+    {
+        return user < users.size() && room < rooms.size();
+    }
+};
@@ -0,0 +1,134 @@
+#include "user.hpp"
+#include "chatroom.hpp"
+#include "search.hpp"
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <unistd.h>
+
+using clock_type = chrono::steady_clock;
+
+// word i of the vocabulary, built from syllables so messages look like text
+static string word(size_t i)
+{
+    static const char* syllables[] = { "ka", "lo", "mi", "ne", "ru", "ta", "vo", "si", "de", "pa",
+                                       "no", "te", "ri", "ma", "zu", "be", "ho", "li", "ga", "fe" };
+    string w;
+    do
+    {
+        w += syllables[i % 20];
+        i /= 20;
+    } while (i);
+    return w;
+}
+
+// the old way: every message tokenized and checked
+static size_t scan(const vector<string>& messages, const vector<string>& words)
+{
+    size_t found = 0;
+    vector<string> tokens;
+    for (auto& m : messages)
+    {
+        tokens.clear();
+        SearchIndex::tokenize(m, [&](const string& w) { tokens.push_back(w); });
+        bool all = true;
+        for (auto& w : words)
+            all = all && find(tokens.begin(), tokens.end(), w) != tokens.end();
+        found += all;
+    }
+    return found;
+}
+
+// Messages with Zipf distributed words (a few very common, most rare), then
+// keyword and phrase queries against the index.
+// usage: ./search [messages] [vocabulary]
+int main(int argc, char* argv[])
+{
+    const size_t n = argc > 1 ? stoul(argv[1]) : 2'000'000;
+    const size_t vocabulary = argc > 2 ? stoul(argv[2]) : 50'000;
+
+    vector<string> words(vocabulary);
+    vector<double> cumulative(vocabulary);
+    double total = 0;
+    for (size_t i = 0; i < vocabulary; ++i)
+    {
+        words[i] = word(i);
+        cumulative[i] = total += 1.0 / (i + 1);
+    }
+    mt19937_64 rng{ 5 };
+    uniform_real_distribution<double> uniform{ 0, total };
+    uniform_int_distribution<int> length{ 4, 16 }, percent{ 0, 99 };
+    auto pick = [&] { return size_t(lower_bound(cumulative.begin(), cumulative.end(), uniform(rng)) - cumulative.begin()); };
+
+    vector<string> messages(n);
+    for (auto& m : messages)
+    {
+        for (int k = length(rng); k > 0; --k)
+            m += words[pick()] + ' ';
+        if (percent(rng) == 0) m += "release notes are out";
+    }
+
+    SearchIndex index;
+    auto start = clock_type::now();
+    for (size_t i = 0; i < n; ++i) index.add(i, messages[i]);
+    chrono::duration<double> building = clock_type::now() - start;
+
+    size_t text_bytes = 0;
+    for (auto& m : messages) text_bytes += m.size();
+    cout << n << " messages, " << index.term_count() << " words, " << text_bytes / (1 << 20) << " MB of text\n"
+         << "  index: " << index.memory_bytes() / (1 << 20) << " MB ("
+         << double(index.memory_bytes()) / n << " bytes/message), "
+         << n / building.count() << " messages/s\n\n";
+
+    struct Query { string text; vector<string> scan_words; };
+    vector<Query> queries = {
+        { words[0], { words[0] } },
+        { words[40000 % vocabulary], { words[40000 % vocabulary] } },
+        { words[0] + " " + words[1], { words[0], words[1] } },
+        { words[0] + " " + words[5000 % vocabulary], { words[0], words[5000 % vocabulary] } },
+        { words[10] + " " + words[20] + " " + words[30], { words[10], words[20], words[30] } },
+        { "\"release notes\"", {} },
+        { "\"notes release\"", {} },
+    };
+    cout << "query                         matches     index ms    scan ms\n";
+    for (auto& q : queries)
+    {
+        start = clock_type::now();
+        auto docs = index.query(q.text);
+        chrono::duration<double, milli> took = clock_type::now() - start;
+        cout << "  " << q.text << string(q.text.size() < 28 ? 28 - q.text.size() : 1, ' ')
+             << docs.size() << "\t" << took.count() << "\t";
+        if (!q.scan_words.empty())
+        {
+            start = clock_type::now();
+            size_t found = scan(messages, q.scan_words);
+            chrono::duration<double, milli> scanning = clock_type::now() - start;
+            cout << scanning.count() << (found == docs.size() ? "" : "  MISMATCH");
+        }
+        cout << "\n";
+    }
+
+    // the same through a room: only what the user received comes back
+    auto file = filesystem::temp_directory_path() / ("chatsearch-" + to_string(getpid()) + ".log");
+    {
+        User john{ "John" }, jane{ "Jane" }, simon{ "Simon" };
+        for (auto u : { &john, &jane, &simon }) u->echo = false;
+        ChatRoom room;
+        room.keep_history(file, 2, true);
+        room.join(&john);
+        room.join(&jane);
+        john.say("the release notes are ready");
+        jane.say("thanks, reading the notes now");
+        john.pm("Jane", "release party on friday, don't tell simon");
+        room.join(&simon);
+        jane.say("simon, the release notes are pinned");
+
+        cout << "\nJane searching \"release\": " << room.search(&jane, "release").size() << " messages\n";
+        for (auto& e : room.search(&simon, "\"release notes\""))
+            cout << "Simon searching \"release notes\": " << *e.message << "\n";
+    }
+    filesystem::remove(file);
+    filesystem::remove(file.string() + ".idx");
+    return 0;
+}
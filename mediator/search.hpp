@@ -0,0 +1,292 @@
+#pragma once
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+// Inverted index over a room's messages, added one at a time as they are
+// sent. A message is a document, identified by its journal sequence number.
+//
+// For every word (lower case letters and digits) the index keeps a postings
+// list of the documents containing it, in order:
+//   varint  document - previous document
+//   varint  size in bytes of the positions that follow
+//   varint* positions of the word in the message, each minus the previous
+// Most entries take 3 bytes. Every 64th entry is also recorded in a skip
+// list, so a list can be jumped forward to a document without decoding
+// everything before it.
+//
+// Queries are words, all of which must appear, and "quoted phrases" whose
+// words must appear next to each other:
+//     deploy "release notes" friday
+class SearchIndex
+{
+    static constexpr uint32_t skip_every = 64;
+
+    struct Skip
+    {
+        uint64_t previous_doc;    // the document before the entry at `offset`
+        size_t offset;
+        uint32_t entry;
+    };
+
+    struct Postings
+    {
+        vector<uint8_t> bytes;
+        vector<Skip> skips;
+        uint64_t last_doc = 0;
+        uint32_t docs = 0;
+    };
+
+    unordered_map<string, Postings> terms;
+    size_t documents = 0;
+
+    // scratch for add()
+    vector<pair<string, uint32_t>> words;
+    vector<uint8_t> position_bytes;
+
+public:
+    template <typename F>
+    static void tokenize(string_view text, F&& on_word)
+    {
+        string word;
+        for (size_t i = 0; i <= text.size(); ++i)
+        {
+            unsigned char c = i < text.size() ? text[i] : ' ';
+            if (isalnum(c))
+            {
+                word += static_cast<char>(tolower(c));
+            }
+            else if (!word.empty())
+            {
+                on_word(word);
+                word.clear();
+            }
+        }
+    }
+
+    // documents have to be added in increasing order
+    void add(uint64_t doc, string_view text)
+    {
+        words.clear();
+        uint32_t position = 0;
+        tokenize(text, [&](const string& w) { words.emplace_back(w, position++); });
+        if (words.empty()) return;
+        ++documents;
+
+        // all positions of a word together, in order
+        stable_sort(words.begin(), words.end(),
+                    [](auto& a, auto& b) { return a.first < b.first; });
+        for (size_t i = 0; i < words.size();)
+        {
+            auto& p = terms[words[i].first];
+            if (p.docs % skip_every == 0)
+                p.skips.push_back({ p.last_doc, p.bytes.size(), p.docs });
+            put_varint(p.bytes, doc - p.last_doc);
+
+            // positions go to scratch first, their size is written before them
+            position_bytes.clear();
+            uint32_t previous = 0;
+            size_t j = i;
+            for (; j < words.size() && words[j].first == words[i].first; ++j)
+            {
+                put_varint(position_bytes, words[j].second - previous);
+                previous = words[j].second;
+            }
+            put_varint(p.bytes, position_bytes.size());
+            p.bytes.insert(p.bytes.end(), position_bytes.begin(), position_bytes.end());
+
+            p.last_doc = doc;
+            ++p.docs;
+            i = j;
+        }
+    }
+
+    // documents matching `query`, in increasing order
+    vector<uint64_t> query(string_view query) const
+    {
+        vector<uint64_t> out;
+        vector<vector<const Postings*>> phrases;
+        vector<const Postings*> all;
+        if (!parse(query, phrases, all)) return out;
+        if (all.empty()) return out;
+
+        // walk the rarest list, jump the others forward to each of its documents
+        sort(all.begin(), all.end(), [](auto a, auto b) { return pair{ a->docs, a } < pair{ b->docs, b }; });
+        all.erase(unique(all.begin(), all.end()), all.end());
+        vector<Cursor> cursors;
+        for (auto p : all) cursors.emplace_back(p);
+
+        vector<vector<uint32_t>> positions;
+        uint64_t target = 0;
+        while (cursors[0].advance_to(target))
+        {
+            uint64_t doc = cursors[0].doc;
+            bool in_all = true;
+            target = doc + 1;
+            for (size_t k = 1; k < cursors.size() && in_all; ++k)
+            {
+                if (!cursors[k].advance_to(doc)) return out;
+                if (cursors[k].doc != doc)
+                {
+                    in_all = false;
+                    target = cursors[k].doc;    // nothing before this can match
+                }
+            }
+            if (in_all && phrases_match(phrases, all, cursors, positions))
+                out.push_back(doc);
+        }
+        return out;
+    }
+
+    size_t document_count() const { return documents; }
+    size_t term_count() const { return terms.size(); }
+
+    size_t memory_bytes() const
+    {
+        size_t total = 0;
+        for (auto& [word, p] : terms)
+            total += sizeof(p) + word.capacity() + p.bytes.capacity() + p.skips.capacity() * sizeof(Skip) + 32;
+        return total;
+    }
+
+private:
+    static size_t encode_varint(uint8_t* out, uint64_t v)
+    {
+        size_t n = 0;
+        while (v >= 0x80)
+        {
+            out[n++] = static_cast<uint8_t>(v) | 0x80;
+            v >>= 7;
+        }
+        out[n++] = static_cast<uint8_t>(v);
+        return n;
+    }
+
+    static void put_varint(vector<uint8_t>& out, uint64_t v)
+    {
+        uint8_t buffer[10];
+        out.insert(out.end(), buffer, buffer + encode_varint(buffer, v));
+    }
+
+    static uint64_t get_varint(const uint8_t*& p)
+    {
+        if (*p < 0x80) return *p++;
+        uint64_t v = 0;
+        for (unsigned shift = 0;; shift += 7)
+        {
+            uint8_t b = *p++;
+            v |= uint64_t(b & 0x7F) << shift;
+            if (b < 0x80) return v;
+        }
+    }
+
+    // Reads one postings list forward. After next()/advance_to() `doc` is
+    // the current document.
+    struct Cursor
+    {
+        const Postings* p;
+        const uint8_t* at;
+        uint32_t entry = 0;        // entries read
+        uint64_t doc = 0;
+        const uint8_t* positions_at = nullptr;
+
+        explicit Cursor(const Postings* p) : p(p), at(p->bytes.data()) {}
+
+        bool next()
+        {
+            if (entry == p->docs) return false;
+            doc += get_varint(at);
+            size_t n = get_varint(at);
+            positions_at = at;
+            at += n;
+            ++entry;
+            return true;
+        }
+
+        // moves to the first document >= target, false if there is none
+        bool advance_to(uint64_t target)
+        {
+            if (entry > 0 && doc >= target) return true;
+            // the last skip point before target, if it is ahead of us
+            auto it = upper_bound(p->skips.begin(), p->skips.end(), target,
+                                  [](uint64_t t, const Skip& s) { return t <= s.previous_doc; });
+            if (it != p->skips.begin() && prev(it)->entry > entry)
+            {
+                auto& s = *prev(it);
+                at = p->bytes.data() + s.offset;
+                entry = s.entry;
+                doc = s.previous_doc;
+            }
+            do
+            {
+                if (!next()) return false;
+            } while (doc < target);
+            return true;
+        }
+
+        // positions of the word in the current document, they end where the
+        // next entry starts
+        void positions(vector<uint32_t>& out) const
+        {
+            out.clear();
+            uint32_t position = 0;
+            for (const uint8_t* q = positions_at; q < at;)
+                out.push_back(position += static_cast<uint32_t>(get_varint(q)));
+        }
+    };
+
+    bool parse(string_view query, vector<vector<const Postings*>>& phrases,
+               vector<const Postings*>& all) const
+    {
+        bool found_all = true;
+        bool quoted = false;
+        size_t start = 0;
+        for (size_t i = 0; i <= query.size(); ++i)
+        {
+            if (i < query.size() && query[i] != '"') continue;
+            auto part = query.substr(start, i - start);
+            vector<const Postings*> words;
+            tokenize(part, [&](const string& w) {
+                auto it = terms.find(w);
+                if (it == terms.end()) found_all = false;
+                else words.push_back(&it->second);
+            });
+            all.insert(all.end(), words.begin(), words.end());
+            if (quoted && words.size() > 1) phrases.push_back(move(words));
+            quoted = !quoted;
+            start = i + 1;
+        }
+        return found_all;
+    }
+
+    static bool phrases_match(const vector<vector<const Postings*>>& phrases,
+                              const vector<const Postings*>& all, const vector<Cursor>& cursors,
+                              vector<vector<uint32_t>>& positions)
+    {
+        for (auto& phrase : phrases)
+        {
+            positions.resize(phrase.size());
+            for (size_t k = 0; k < phrase.size(); ++k)
+            {
+                size_t c = find(all.begin(), all.end(), phrase[k]) - all.begin();
+                cursors[c].positions(positions[k]);
+            }
+            // a start position with word k at start + k for every k
+            bool matched = false;
+            for (uint32_t start : positions[0])
+            {
+                matched = true;
+                for (size_t k = 1; k < phrase.size() && matched; ++k)
+                    matched = binary_search(positions[k].begin(), positions[k].end(), start + uint32_t(k));
+                if (matched) break;
+            }
+            if (!matched) return false;
+        }
+        return true;
+    }
+};
@@ -0,0 +1,343 @@
+#include "user.hpp"
+#include "chatroom.hpp"
+#include "protocol.hpp"
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// The ChatRoom mediator behind a socket: one process, one thread, one epoll.
+//
+// Every connection becomes a User once it sends HELLO. SAY and PM frames are
+// turned into say()/pm() calls, and the user's on_receive hook queues what
+// it receives on its connection. Queued messages are written after each
+// round of events, many frames per writev, pointing straight at the shared
+// message's origin and text.
+//
+// usage: ./server [--port N] [--unix PATH] [--log K]   (--port 0: unix socket only)
+
+namespace
+{
+    constexpr size_t max_queued = 4096;     // messages; a connection further behind is dropped
+    constexpr size_t iov_batch = 1020;      // 3 iovecs per message
+
+    struct Connection
+    {
+        int fd;
+        unique_ptr<User> user;
+        string partial;                     // an incomplete frame from the last read
+        deque<MessagePtr> out;
+        size_t out_offset = 0;              // bytes of out.front()'s frame already sent
+        bool dirty = false;                 // in the flush list
+        bool closing = false;
+    };
+
+    struct Server
+    {
+        int epoll_fd;
+        vector<int> listeners;
+        vector<unique_ptr<Connection>> connections;   // by fd
+        vector<Connection*> dirty;
+        // closed this round; freed (and their users removed from the room)
+        // after the flush, nothing may still be using them then
+        vector<unique_ptr<Connection>> closed;
+        ChatRoom room;
+        size_t log_capacity;
+        size_t open = 0, peak = 0;
+        uint64_t frames_in = 0, frames_out = 0, dropped = 0;
+
+        ~Server()
+        {
+            // users leave before the room goes away
+            for (auto& c : connections)
+                if (c && c->user) room.leave(c->user.get(), false);
+            for (auto& c : closed)
+                if (c->user) room.leave(c->user.get(), false);
+        }
+    };
+
+    [[noreturn]] void die(const string& what)
+    {
+        cerr << what << ": " << strerror(errno) << "\n";
+        exit(1);
+    }
+
+    int listen_tcp(uint16_t port)
+    {
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof one);
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        addr.sin_port = htons(port);
+        if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof addr) < 0) die("bind");
+        if (listen(fd, SOMAXCONN) < 0) die("listen");
+        return fd;
+    }
+
+    int listen_unix(const string& path)
+    {
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, path.c_str(), sizeof addr.sun_path - 1);
+        unlink(path.c_str());
+        if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof addr) < 0) die("bind " + path);
+        if (listen(fd, SOMAXCONN) < 0) die("listen");
+        return fd;
+    }
+
+    // Can happen in the middle of a broadcast (a lagging reader), so the
+    // user only leaves the room in reap().
+    void close_connection(Server& s, Connection& c)
+    {
+        if (c.closing) return;
+        c.closing = true;
+        epoll_ctl(s.epoll_fd, EPOLL_CTL_DEL, c.fd, nullptr);
+        close(c.fd);
+        --s.open;
+        s.closed.push_back(move(s.connections[c.fd]));
+    }
+
+    void reap(Server& s)
+    {
+        for (auto& c : s.closed)
+            if (c->user) s.room.leave(c->user.get(), false);
+        s.closed.clear();
+    }
+
+    void queue(Server& s, Connection& c, const MessagePtr& m)
+    {
+        if (c.closing) return;
+        if (c.out.size() >= max_queued)
+        {
+            ++s.dropped;
+            close_connection(s, c);
+            return;
+        }
+        c.out.push_back(m);
+        if (!c.dirty)
+        {
+            c.dirty = true;
+            s.dirty.push_back(&c);
+        }
+    }
+
+    void on_frame(Server& s, Connection& c, protocol::Type type, string_view payload)
+    {
+        ++s.frames_in;
+        if (!c.user)
+        {
+            if (type != protocol::hello || payload.empty())
+                return close_connection(s, c);
+            c.user = make_unique<User>(string{ payload }, s.log_capacity);
+            c.user->echo = false;
+            c.user->on_receive = [&s, &c](const MessagePtr& m) { queue(s, c, m); };
+            if (!s.room.join(c.user.get(), false))
+            {
+                c.user.reset();             // name taken
+                close_connection(s, c);
+            }
+            return;
+        }
+        switch (type)
+        {
+        case protocol::say:
+            c.user->say(string{ payload });
+            break;
+        case protocol::pm:
+        {
+            string_view who, text;
+            if (!protocol::split_addressed(payload, who, text))
+                return close_connection(s, c);
+            c.user->pm(string{ who }, string{ text });
+            break;
+        }
+        default:
+            close_connection(s, c);
+        }
+    }
+
+    void read_from(Server& s, Connection& c)
+    {
+        static char buffer[256 << 10];
+        while (!c.closing)
+        {
+            // a leftover partial frame goes in front of the new bytes
+            size_t have = c.partial.size();
+            memcpy(buffer, c.partial.data(), have);
+            ssize_t n = read(c.fd, buffer + have, sizeof buffer - have);
+            if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR))
+                return close_connection(s, c);
+            if (n < 0)
+            {
+                if (errno == EINTR) continue;
+                return;
+            }
+            size_t total = have + n;
+            size_t used = protocol::parse(buffer, total, [&](protocol::Type type, string_view payload) {
+                if (!c.closing) on_frame(s, c, type, payload);
+            });
+            if (used == SIZE_MAX)
+                return close_connection(s, c);
+            c.partial.assign(buffer + used, total - used);
+        }
+    }
+
+    // writes as much of the queue as the socket takes
+    void flush(Server& s, Connection& c)
+    {
+        static iovec iov[iov_batch];
+        static char headers[iov_batch / 3][protocol::msg_header_size];
+        while (!c.out.empty())
+        {
+            size_t n_iov = 0, frames = 0;
+            for (auto& m : c.out)
+            {
+                if (n_iov + 3 > iov_batch) break;
+                char* h = headers[frames++];
+                protocol::put_u32(h, static_cast<uint32_t>(3 + m->origin.size() + m->text.size()));
+                h[4] = static_cast<char>(protocol::msg);
+                protocol::put_u16(h + 5, static_cast<uint16_t>(m->origin.size()));
+                iov[n_iov++] = { h, protocol::msg_header_size };
+                iov[n_iov++] = { const_cast<char*>(m->origin.data()), m->origin.size() };
+                iov[n_iov++] = { const_cast<char*>(m->text.data()), m->text.size() };
+            }
+            // skip what an earlier partial write already sent
+            size_t skip = c.out_offset, first = 0;
+            while (skip >= iov[first].iov_len && skip > 0)
+                skip -= iov[first++].iov_len;
+            iov[first].iov_base = static_cast<char*>(iov[first].iov_base) + skip;
+            iov[first].iov_len -= skip;
+
+            ssize_t written = writev(c.fd, iov + first, static_cast<int>(n_iov - first));
+            if (written < 0)
+            {
+                if (errno == EINTR) continue;
+                if (errno != EAGAIN) close_connection(s, c);
+                return;                     // EPOLLOUT resumes it
+            }
+
+            size_t left = c.out_offset + written;
+            while (!c.out.empty())
+            {
+                auto& m = c.out.front();
+                size_t size = protocol::msg_header_size + m->origin.size() + m->text.size();
+                if (left < size) break;
+                left -= size;
+                c.out.pop_front();
+                ++s.frames_out;
+            }
+            c.out_offset = left;
+        }
+    }
+
+    void accept_from(Server& s, int listener)
+    {
+        for (;;)
+        {
+            int fd = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK);
+            if (fd < 0)
+            {
+                if (errno == EINTR || errno == ECONNABORTED) continue;
+                if (errno == EMFILE || errno == ENFILE) cerr << "out of file descriptors\n";
+                return;
+            }
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);    // fails harmlessly on unix sockets
+            if (size_t(fd) >= s.connections.size()) s.connections.resize(fd + 1024);
+            s.connections[fd] = make_unique<Connection>();
+            s.connections[fd]->fd = fd;
+
+            epoll_event ev{};
+            ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+            ev.data.fd = fd;
+            epoll_ctl(s.epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+            s.peak = max(s.peak, ++s.open);
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    uint16_t port = 9000;
+    string unix_path;
+    size_t log_capacity = 64;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        string flag = argv[i];
+        if (flag == "--port") port = static_cast<uint16_t>(stoul(argv[i + 1]));
+        else if (flag == "--unix") unix_path = argv[i + 1];
+        else if (flag == "--log") log_capacity = stoul(argv[i + 1]);
+    }
+    signal(SIGPIPE, SIG_IGN);
+    auto fd_limit = protocol::raise_fd_limit();
+
+    Server s;
+    s.log_capacity = log_capacity;
+    s.epoll_fd = epoll_create1(0);
+    if (port) s.listeners.push_back(listen_tcp(port));
+    if (!unix_path.empty()) s.listeners.push_back(listen_unix(unix_path));
+    for (int fd : s.listeners)
+    {
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        epoll_ctl(s.epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+    }
+    cout << "listening on " << (port ? "port " + to_string(port) : string{})
+         << (unix_path.empty() ? "" : (port ? " and " : "") + unix_path)
+         << ", up to " << fd_limit << " file descriptors" << endl;
+
+    vector<epoll_event> events(4096);
+    for (;;)
+    {
+        int n = epoll_wait(s.epoll_fd, events.data(), static_cast<int>(events.size()), 1000);
+        if (n < 0 && errno != EINTR) die("epoll_wait");
+        for (int i = 0; i < n; ++i)
+        {
+            int fd = events[i].data.fd;
+            if (find(s.listeners.begin(), s.listeners.end(), fd) != s.listeners.end())
+            {
+                accept_from(s, fd);
+                continue;
+            }
+            auto& c = s.connections[fd];
+            if (!c || c->closing) continue;
+            if (events[i].events & EPOLLIN)
+                read_from(s, *c);
+            if (c && !c->closing && (events[i].events & (EPOLLERR | EPOLLHUP)))
+                close_connection(s, *c);
+            else if (c && !c->closing && (events[i].events & EPOLLOUT) && !c->out.empty() && !c->dirty)
+            {
+                c->dirty = true;
+                s.dirty.push_back(c.get());
+            }
+        }
+
+        // one writev batch per connection with something queued this round
+        for (auto c : s.dirty)
+        {
+            c->dirty = false;
+            if (!c->closing) flush(s, *c);
+        }
+        s.dirty.clear();
+        reap(s);
+
+        if (n == 0 && s.open)
+            cout << s.open << " connections (peak " << s.peak << "), " << s.frames_in
+                 << " frames in, " << s.frames_out << " out, " << s.dropped << " dropped for lagging" << endl;
+    }
+}
@@ -2,7 +2,7 @@
 #include "chatroom.hpp"
 #include <iostream>
 
-User::User(const string &name) : name(name) {}
+User::User(const string &name, size_t log_capacity) : name(name), chat_log(log_capacity) {}
 
 void User::say(const string &message) const
 {
@@ -16,9 +16,22 @@ void User::pm(const string &who, const string &message) const
 
 void User::receive(const string &origin, const string &message)
 {
-    string s{origin + ": \"" + message + "\""};
-    std::cout << "[" << name << "'s chat session]" << s << "\n";
-    chat_log.emplace_back(s);
+    receive(make_message(origin, message));
+}
+
+void User::receive(const MessagePtr &message, uint64_t seq)
+{
+    if (echo)
+        std::cout << "[" << name << "'s chat session]" << *message << "\n";
+    chat_log.push_back(message, seq);
+    if (on_receive)
+        on_receive(message);
+}
+
+void User::display(ostream &os) const
+{
+    for (auto &m : chat_log)
+        os << *m << "\n";
 }
 
 bool User::operator==(const User &rhs) const {
@@ -1,6 +1,10 @@
 #pragma once
+#include <functional>
+#include <ostream>
 #include <string>
 #include <vector>
+#include "chatlog.hpp"
+#include "message.hpp"
 using namespace std;
 
 struct ChatRoom;
@@ -8,14 +12,23 @@ struct ChatRoom;
 struct User {
     string name;
     ChatRoom* room{nullptr};
-    vector<string> chat_log;
+    ChatLog chat_log;     // the last log_capacity messages, or the room's per_user
+    bool echo{true};    // print received messages to the console
 
-    User(const string &name);
+    // called with every message received, e.g. to send it over the network
+    function<void(const MessagePtr&)> on_receive;
+
+    User(const string &name, size_t log_capacity = 1024);
 
     void say(const string& message) const;
     void pm(const string& who, const string& message) const;
 
     void receive(const string& origin, const string& message);
+    // `seq`: where the message is in the room's journal, if it keeps one
+    void receive(const MessagePtr& message, uint64_t seq = ChatLog::unjournaled);
+
+    // prints the whole chat log, the only place messages are formatted
+    void display(ostream& os) const;
 
     bool operator==(const User &rhs) const;
 
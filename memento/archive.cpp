@@ -0,0 +1,83 @@
+#include <iostream>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "mementoarchive.hpp"
+using namespace std;
+
+// A realistic account: one memento per tick (think autosave), most ticks
+// nothing happens, salary/rent/subscriptions recur every month and card
+// payments come from a small set of usual amounts.
+vector<int> balance_history(size_t n)
+{
+    mt19937 rng{ 2024 };
+    const int usual[] = { -4, -4, -12, -35, -50, -9, -60, -120, -18, -25, 20, -7 };
+    uniform_int_distribution<int> pick{ 0, 11 }, percent{ 0, 99 };
+
+    vector<int> history;
+    history.reserve(n);
+    int balance = 2500;
+    for (size_t t = 0; t < n; ++t)
+    {
+        switch (t % 720)   // a month of hourly ticks
+        {
+        case 0:   balance += 3200; break;   // salary
+        case 24:  balance -= 1150; break;   // rent
+        case 100: balance -= 15;   break;   // subscriptions
+        case 300: balance -= 11;   break;
+        default:
+            if (percent(rng) < 4) balance += usual[pick(rng)];
+        }
+        history.push_back(balance);
+    }
+    return history;
+}
+
+// usage: ./archive [versions] [block size]
+int main(int argc, char* argv[])
+{
+    const size_t n = argc > 1 ? stoul(argv[1]) : 10'000'000;
+    const size_t block = argc > 2 ? stoul(argv[2]) : 4096;
+    using clock = chrono::steady_clock;
+
+    auto history = balance_history(n);
+
+    auto start = clock::now();
+    MementoArchiveWriter writer{ block };
+    for (int b : history) writer.append(b);
+    auto bytes = writer.finish();
+    chrono::duration<double> encoding = clock::now() - start;
+
+    MementoArchive archive{ bytes.data(), bytes.size() };
+    vector<int> decoded;
+    start = clock::now();
+    archive.decode_all(decoded);
+    chrono::duration<double> decoding = clock::now() - start;
+
+    mt19937 rng{ 1 };
+    uniform_int_distribution<size_t> version{ 0, n - 1 };
+    const size_t lookups = 100'000;
+    bool ok = decoded == history;
+    start = clock::now();
+    for (size_t i = 0; i < lookups; ++i)
+    {
+        size_t v = version(rng);
+        ok &= *archive.at(v) == history[v];
+    }
+    chrono::duration<double, micro> random_access = clock::now() - start;
+
+    double raw = n * sizeof(int);
+    // shared_ptr in the vector + make_shared's control block and int
+    double shared = n * (sizeof(shared_ptr<int>) + 32.0);
+    cout << n << " versions, " << bytes.size() << " bytes ("
+         << bytes.size() / double(n) << " bytes/version)\n"
+         << "  " << raw / bytes.size() << "x smaller than raw int32, "
+         << shared / bytes.size() << "x smaller than vector<shared_ptr<Memento>>\n"
+         << "  encode " << raw / encoding.count() / 1e9 << " GB/s, decode "
+         << raw / decoding.count() / 1e9 << " GB/s (of int32 balances)\n"
+         << "  random access " << random_access.count() / lookups << " us/version\n"
+         << "  round trip " << (ok ? "ok" : "MISMATCH") << "\n";
+    return 0;
+}
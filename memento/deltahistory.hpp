@@ -0,0 +1,97 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <optional>
+#include <vector>
+using namespace std;
+
+// Undo/redo history for an int state that keeps the *change* between two
+// states instead of a copy of every state.
+//
+// Every recorded state gets a version number. The deltas live in a fixed size
+// ring, once `capacity` undos are stored recording drops the oldest version
+// (its delta is folded into `oldest`, the state at the first reachable
+// version), so memory never grows past `capacity` deltas. Every
+// `checkpoint_every` versions the full state is also kept so any reachable
+// version can be rebuilt with at most `checkpoint_every` deltas.
+//
+// undo()/redo() apply a single delta: O(1), no allocation.
+class DeltaHistory
+{
+    vector<int> deltas;          // deltas[v % size] takes version v-1 to v
+    vector<int> checkpoints;     // checkpoints[(v / every) % size] = state at v
+    size_t every;
+    size_t first = 0;            // oldest version still reachable
+    size_t current = 0;          // version of the present state
+    size_t last = 0;             // newest version, redo stops here
+    int oldest;                  // state at version `first`
+    int state;                   // state at version `current`
+
+public:
+    explicit DeltaHistory(int initial, size_t capacity = 1024, size_t checkpoint_every = 64)
+        : deltas(max<size_t>(capacity, 1) + 1),
+          checkpoints(max<size_t>(capacity, 1) / max<size_t>(checkpoint_every, 1) + 2),
+          every(max<size_t>(checkpoint_every, 1)), oldest(initial), state(initial)
+    {
+        checkpoints[0] = initial;
+    }
+
+    // A new state after `current`. Anything that could have been redone is
+    // gone: the history is a line, not a tree.
+    void record(int new_state)
+    {
+        last = ++current;
+        deltas[current % deltas.size()] = new_state - state;
+        state = new_state;
+        if (current % every == 0)
+            checkpoints[(current / every) % checkpoints.size()] = state;
+
+        // the slot just written held the delta of version `first`, which
+        // was never needed, `first + 1`'s delta is still intact
+        if (last - first == deltas.size())
+        {
+            ++first;
+            oldest += deltas[first % deltas.size()];
+        }
+    }
+
+    optional<int> undo()
+    {
+        if (current == first) return {};
+        state -= deltas[current % deltas.size()];
+        --current;
+        return state;
+    }
+
+    optional<int> redo()
+    {
+        if (current == last) return {};
+        ++current;
+        state += deltas[current % deltas.size()];
+        return state;
+    }
+
+    // state at any reachable version, starting from the closest checkpoint
+    optional<int> at(size_t version) const
+    {
+        if (version < first || version > last) return {};
+        size_t from = version / every * every;
+        int s;
+        if (from <= first)
+        {
+            from = first;
+            s = oldest;
+        }
+        else
+        {
+            s = checkpoints[(from / every) % checkpoints.size()];
+        }
+        for (size_t v = from + 1; v <= version; ++v)
+            s += deltas[v % deltas.size()];
+        return s;
+    }
+
+    size_t version() const { return current; }
+    size_t oldest_version() const { return first; }
+    size_t newest_version() const { return last; }
+};
@@ -2,15 +2,21 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <optional>
+#include "deltahistory.hpp"
+#include "spillhistory.hpp"
+#include "undotree.hpp"
 using namespace std;
 
+template <typename History> class BankAccount2;
+
 class Memento
 {
     int balance;
 public:
     Memento(int balance) : balance(balance) {}
     friend class BankAccount;
-    friend class BankAccount2;
+    template <typename History> friend class BankAccount2;
 };
 
 class BankAccount
@@ -36,63 +42,67 @@ public:
     }
 };
 
-class BankAccount2 // supports undo/redo
+// supports undo/redo, History decides how the past states are kept
+template <typename History = DeltaHistory>
+class BankAccount2
 {
     int balance = 0;
-    vector<shared_ptr<Memento>> changes;
-    int current;
+    History changes;
 public:
-    explicit BankAccount2(const int balance)
-        : balance(balance)
+    // extra arguments configure the history, i.e. how many changes to keep
+    template <typename... Args>
+    explicit BankAccount2(const int balance, Args&&... history_args)
+        : balance(balance), changes(balance, forward<Args>(history_args)...)
+    {}
+
+    Memento deposit(int amount)
     {
-        changes.emplace_back(make_shared<Memento>(balance));
-        current = 0;
+        balance += amount;
+        changes.record(balance);
+        return Memento{ balance };
     }
 
-    shared_ptr<Memento> deposit(int amount)
+    void restore(const Memento& m)
     {
-        balance += amount;
-        auto m = make_shared<Memento>(balance);
-        changes.push_back(m);
-        ++current;
-        return m;
+        balance = m.balance;
+        changes.record(balance);
     }
 
-    void restore(const shared_ptr<Memento>& m)
+    optional<Memento> undo()
     {
-        if (m)
+        if (auto b = changes.undo())
         {
-            balance = m->balance;
-            changes.push_back(m);
-            current = changes.size() - 1;
+            balance = *b;
+            return Memento{ balance };
         }
-        cout << "Cannot restore: memento is invalid." << endl;
+        cout << "Cannot undo: already at oldest state." << endl;
+        return {};
     }
 
-    shared_ptr<Memento> undo()
+    // only for histories that are trees, i.e. UndoTree
+    optional<Memento> jump(size_t version)
     {
-        if (current > 0)
+        if (auto b = changes.jump(version))
         {
-            --current;
-            auto m = changes[current];
-            balance = m->balance;
-            return m;
+            balance = *b;
+            return Memento{ balance };
         }
-        cout << "Cannot undo: already at oldest state." << endl;
-        return{}; // returning a null shared_ptr
+        cout << "Cannot jump: no state " << version << "." << endl;
+        return {};
     }
 
-    shared_ptr<Memento> redo()
+    size_t version() const { return changes.version(); }
+    const History& history() const { return changes; }
+
+    optional<Memento> redo()
     {
-        if (current + 1 < changes.size())
+        if (auto b = changes.redo())
         {
-            ++current;
-            auto m = changes[current];
-            balance = m->balance;
-            return m;
+            balance = *b;
+            return Memento{ balance };
         }
         cout << "Cannot redo: already at latest state." << endl;
-        return{}; // returning a null shared_ptr
+        return {};
     }
 
     friend ostream& operator<<(ostream& os, const BankAccount2& obj)
@@ -120,8 +130,8 @@ void memento()
 void undo_redo()
 {
     BankAccount2 ba{ 100 };
-    // auto mem1 = ba.deposit(50);
-    // ba.deposit(25); // 125
+    ba.deposit(50);  // 150
+    ba.deposit(25);  // 175
     cout << ba << "\n";
 
     auto mem1 = ba.undo();
@@ -131,14 +141,69 @@ void undo_redo()
     ba.redo();
     cout << "Redo 2: " << ba << "\n";
 
-    // 
-    ba.restore(mem1);
+    ba.restore(*mem1);
+    cout << "Restore: " << ba << "\n";
+}
+
+void bounded_history()
+{
+    // only the last 4 changes are kept
+    BankAccount2 ba{ 0, 4 };
+    for (int i = 1; i <= 10; ++i)
+        ba.deposit(i);
+    cout << ba << "\n";
+
+    while (ba.undo())
+        cout << "Undo: " << ba << "\n";
+}
+
+void deep_undo()
+{
+    // 8 states in RAM, older ones go to disk in segments of 16
+    BankAccount2<SpillHistory> ba{ 0, 8, 16 };
+    for (int i = 1; i <= 100; ++i)
+        ba.deposit(i);
+    cout << ba << "\n";
+
+    // undo back to the start, everything past the first few comes from disk
+    for (int i = 0; i < 100; ++i)
+        ba.undo();
+    cout << "Undo x100: " << ba << "\n";
+    for (int i = 0; i < 50; ++i)
+        ba.redo();
+    cout << "Redo x50: " << ba << "\n";
+}
+
+void undo_tree()
+{
+    BankAccount2<UndoTree> ba{ 100 };
+    ba.deposit(50);                  // state 1: 150
+    ba.deposit(25);                  // state 2: 175
+    auto first_branch = ba.version();
+
+    ba.undo();
+    ba.undo();
+    ba.deposit(1000);                // state 3: 1100, a new branch off state 0
+    ba.deposit(1);                   // state 4: 1101
+    cout << ba << "\n";
+
+    ba.jump(first_branch);
+    cout << "Jump to " << first_branch << ": " << ba << " (" << ba.history().deltas_applied()
+         << " deltas applied)\n";
+    ba.undo();
+    ba.redo();                       // redo follows the branch jumped to
+    cout << "Undo + redo: " << ba << "\n";
+    ba.jump(4);
+    cout << "Jump to 4: " << ba << " (" << ba.history().deltas_applied() << " deltas applied)\n";
 }
 
 int main()
 {
     // memento()
     undo_redo();
+    bounded_history();
+    deep_undo();
+    undo_tree();
 
     return 0;
 }
@@ -0,0 +1,307 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+using namespace std;
+
+// Serialized history of balances (one per memento), for keeping audits.
+//
+// Layout
+//   block*    every block holds `block_size` consecutive versions
+//   index     offset of every block, varints
+//   footer    index offset, version count, block size (fixed 8 bytes each)
+//
+// A block is the first balance followed by the delta to each next balance,
+// all zigzag varints (small changes take 1-2 bytes), then squeezed by a small
+// LZ77 compressor, which is what removes recurring amounts and runs of
+// unchanged balances. Reading version v only decodes the block containing it,
+// found through the index (a sparse index: one entry per block, not per version).
+namespace archive
+{
+    // ---- varints ---------------------------------------------------------
+
+    inline void put_varint(vector<uint8_t>& out, uint64_t v)
+    {
+        while (v >= 0x80)
+        {
+            out.push_back(static_cast<uint8_t>(v) | 0x80);
+            v >>= 7;
+        }
+        out.push_back(static_cast<uint8_t>(v));
+    }
+
+    inline uint64_t get_varint(const uint8_t*& p)
+    {
+        if (*p < 0x80) return *p++;     // most deltas fit in one byte
+        uint64_t v = 0;
+        for (unsigned shift = 0;; shift += 7)
+        {
+            uint8_t b = *p++;
+            v |= uint64_t(b & 0x7F) << shift;
+            if (b < 0x80) return v;
+        }
+    }
+
+    inline uint64_t zigzag(int64_t v) { return (uint64_t(v) << 1) ^ uint64_t(v >> 63); }
+    inline int64_t unzigzag(uint64_t v) { return int64_t(v >> 1) ^ -int64_t(v & 1); }
+
+    inline void put_u64(vector<uint8_t>& out, uint64_t v)
+    {
+        for (int i = 0; i < 8; ++i) out.push_back(static_cast<uint8_t>(v >> (8 * i)));
+    }
+
+    inline uint64_t get_u64(const uint8_t* p)
+    {
+        uint64_t v;
+        memcpy(&v, p, 8);
+        return v;
+    }
+
+    // ---- LZ77 ------------------------------------------------------------
+    // Sequences of: token (literal count << 4 | match length - 4), literals,
+    // 2 byte match offset. A nibble of 15 is continued with 255-bytes. The last
+    // sequence only has literals.
+
+    constexpr size_t min_match = 4;
+
+    inline void put_length(vector<uint8_t>& out, size_t n)
+    {
+        for (; n >= 255; n -= 255) out.push_back(255);
+        out.push_back(static_cast<uint8_t>(n));
+    }
+
+    inline void compress(const uint8_t* in, size_t n, vector<uint8_t>& out)
+    {
+        constexpr int hash_bits = 12;
+        uint32_t table[1 << hash_bits] = {};    // position + 1 of the last 4 bytes with this hash
+        auto hash4 = [&](size_t i) {
+            uint32_t v;
+            memcpy(&v, in + i, 4);
+            return (v * 2654435761u) >> (32 - hash_bits);
+        };
+
+        size_t anchor = 0, i = 0;
+        auto emit = [&](size_t literals_end, size_t match_len, size_t offset) {
+            size_t lit = literals_end - anchor;
+            size_t ml = match_len ? match_len - min_match : 0;
+            out.push_back(static_cast<uint8_t>((min<size_t>(lit, 15) << 4) | min<size_t>(ml, 15)));
+            if (lit >= 15) put_length(out, lit - 15);
+            out.insert(out.end(), in + anchor, in + literals_end);
+            if (!match_len) return;
+            out.push_back(static_cast<uint8_t>(offset));
+            out.push_back(static_cast<uint8_t>(offset >> 8));
+            if (ml >= 15) put_length(out, ml - 15);
+        };
+
+        while (i + min_match <= n)
+        {
+            auto h = hash4(i);
+            size_t candidate = table[h];
+            table[h] = static_cast<uint32_t>(i + 1);
+            if (candidate && i - (candidate - 1) < 65536 && memcmp(in + candidate - 1, in + i, 4) == 0)
+            {
+                size_t from = candidate - 1, len = min_match;
+                while (i + len < n && in[from + len] == in[i + len]) ++len;
+                emit(i, len, i - from);
+                i += len;
+                anchor = i;
+            }
+            else
+            {
+                ++i;
+            }
+        }
+        emit(n, 0, 0);
+    }
+
+    inline size_t get_length(const uint8_t*& p, size_t nibble)
+    {
+        if (nibble < 15) return nibble;
+        size_t n = 15;
+        uint8_t b;
+        do { b = *p++; n += b; } while (b == 255);
+        return n;
+    }
+
+    // Short literals and matches are copied as a fixed 16 bytes (one
+    // instruction or two instead of a memcpy call), so `out` needs
+    // `copy_slack` bytes of room past the block and the input may be read up
+    // to 16 bytes past `end`, which the index and footer after the last
+    // block always cover.
+    constexpr size_t copy_slack = 32;
+
+    inline void decompress(const uint8_t* p, const uint8_t* end, uint8_t* out)
+    {
+        while (p < end)
+        {
+            uint8_t token = *p++;
+            size_t lit = get_length(p, token >> 4);
+            if (lit <= 16) memcpy(out, p, 16);
+            else           memcpy(out, p, lit);
+            out += lit;
+            p += lit;
+            if (p >= end) break;
+
+            size_t offset = p[0] | (size_t(p[1]) << 8);
+            p += 2;
+            size_t len = get_length(p, token & 15) + min_match;
+            const uint8_t* from = out - offset;
+            if (offset >= 16 && len <= 16)
+            {
+                memcpy(out, from, 16);
+            }
+            else if (offset == 1)
+            {
+                memset(out, *from, len);    // a run of one byte, i.e. unchanged balances
+            }
+            else
+            {
+                // A match closer than its length repeats a pattern. Copying
+                // from the start of the pattern, each copy can be as long as
+                // everything written so far: doubling steps.
+                for (size_t done = 0; done < len;)
+                {
+                    size_t chunk = min(len - done, offset + done);
+                    memcpy(out + done, from, chunk);
+                    done += chunk;
+                }
+            }
+            out += len;
+        }
+    }
+
+    // ---- blocks ----------------------------------------------------------
+
+    inline void encode_block(const int* balances, size_t n, vector<uint8_t>& raw, vector<uint8_t>& out)
+    {
+        raw.clear();
+        int64_t previous = 0;
+        for (size_t i = 0; i < n; ++i)
+        {
+            put_varint(raw, zigzag(int64_t(balances[i]) - previous));
+            previous = balances[i];
+        }
+        put_varint(out, raw.size());
+        vector<uint8_t> packed;
+        compress(raw.data(), raw.size(), packed);
+        put_varint(out, packed.size());
+        out.insert(out.end(), packed.begin(), packed.end());
+    }
+}
+
+class MementoArchiveWriter
+{
+    size_t block_size;
+    vector<int> pending;
+    vector<uint8_t> out, raw;
+    vector<uint64_t> offsets;
+    size_t count = 0;
+
+public:
+    explicit MementoArchiveWriter(size_t block_size = 4096) : block_size(max<size_t>(block_size, 1)) {}
+
+    void append(int balance)
+    {
+        pending.push_back(balance);
+        ++count;
+        if (pending.size() == block_size) flush_block();
+    }
+
+    vector<uint8_t> finish()
+    {
+        if (!pending.empty()) flush_block();
+        uint64_t index_at = out.size();
+        archive::put_varint(out, offsets.size());
+        uint64_t previous = 0;
+        for (auto o : offsets)
+        {
+            archive::put_varint(out, o - previous);
+            previous = o;
+        }
+        archive::put_u64(out, index_at);
+        archive::put_u64(out, count);
+        archive::put_u64(out, block_size);
+        return move(out);
+    }
+
+private:
+    void flush_block()
+    {
+        offsets.push_back(out.size());
+        archive::encode_block(pending.data(), pending.size(), raw, out);
+        pending.clear();
+    }
+};
+
+class MementoArchive
+{
+    const uint8_t* data;
+    size_t length;
+    size_t count, block_size;
+    vector<uint64_t> offsets;
+
+    // the last decoded block, sequential reads don't decode it again
+    size_t cached_block = SIZE_MAX;
+    vector<int> balances;
+    vector<uint8_t> raw;
+
+public:
+    // the bytes have to outlive the archive
+    MementoArchive(const uint8_t* data, size_t length) : data(data), length(length)
+    {
+        if (length < 24) throw runtime_error("memento archive too short");
+        const uint8_t* footer = data + length - 24;
+        uint64_t index_at = archive::get_u64(footer);
+        count = archive::get_u64(footer + 8);
+        block_size = archive::get_u64(footer + 16);
+        if (block_size == 0) throw runtime_error("memento archive with 0 versions per block");
+
+        const uint8_t* p = data + index_at;
+        offsets.resize(archive::get_varint(p));
+        uint64_t previous = 0;
+        for (auto& o : offsets) o = previous += archive::get_varint(p);
+    }
+
+    size_t size() const { return count; }
+
+    optional<int> at(size_t version)
+    {
+        if (version >= count) return {};
+        size_t block = version / block_size;
+        if (block != cached_block) decode_block(block, balances);
+        return balances[version % block_size];
+    }
+
+    // appends every version to `out`
+    void decode_all(vector<int>& out)
+    {
+        out.reserve(out.size() + count);
+        vector<int> block_balances;
+        for (size_t b = 0; b < offsets.size(); ++b)
+        {
+            decode_block(b, block_balances);
+            out.insert(out.end(), block_balances.begin(), block_balances.end());
+        }
+    }
+
+private:
+    void decode_block(size_t block, vector<int>& into)
+    {
+        const uint8_t* p = data + offsets[block];
+        size_t raw_size = archive::get_varint(p);
+        size_t packed_size = archive::get_varint(p);
+        raw.resize(raw_size + archive::copy_slack);
+        archive::decompress(p, p + packed_size, raw.data());
+
+        size_t n = min(block_size, count - block * block_size);
+        into.resize(n);
+        const uint8_t* r = raw.data();
+        int64_t previous = 0;
+        for (size_t i = 0; i < n; ++i)
+            into[i] = static_cast<int>(previous += archive::unzigzag(archive::get_varint(r)));
+        if (&into == &balances) cached_block = block;
+    }
+};
@@ -0,0 +1,128 @@
+#pragma once
+#include <bit>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+using namespace std;
+
+// Persistent hash map (a HAMT: hash array mapped trie) from uint64_t keys to V.
+//
+// The map is a tree of nodes with up to 32 slots each, picked by 5 bits of the
+// key's hash at a time. Copying a PersistentMap only copies the root pointer,
+// so the copy and the original share every node. set() copies just the nodes
+// on the path from the root to the key (at most 13 of them) when they are
+// shared with a copy, and changes nodes nobody else sees in place. That makes
+// a snapshot of the whole map O(1), which is what a memento needs.
+//
+// Keys go through a bijective hash (splitmix64's finalizer), so 2 different
+// keys always differ somewhere in their 64 hash bits and no collision
+// buckets are needed.
+template <typename V>
+class PersistentMap
+{
+    struct Node
+    {
+        uint32_t datamap = 0;    // slots holding a key/value
+        uint32_t nodemap = 0;    // slots holding a child node
+        vector<pair<uint64_t, V>> data;        // in slot order
+        vector<shared_ptr<Node>> children;     // in slot order
+    };
+    using NodePtr = shared_ptr<Node>;
+
+    NodePtr root = make_shared<Node>();
+    size_t count = 0;
+
+    static uint64_t hash(uint64_t k)
+    {
+        k = (k ^ (k >> 30)) * 0xBF58476D1CE4E5B9ull;
+        k = (k ^ (k >> 27)) * 0x94D049BB133111EBull;
+        return k ^ (k >> 31);
+    }
+
+    static uint32_t bit_at(uint64_t h, unsigned shift) { return 1u << ((h >> shift) & 31); }
+    static unsigned index(uint32_t map, uint32_t bit) { return popcount(map & (bit - 1)); }
+
+    // a node shared with a snapshot is copied before it is changed
+    static Node& own(NodePtr& n)
+    {
+        if (n.use_count() > 1) n = make_shared<Node>(*n);
+        return *n;
+    }
+
+    static NodePtr split(pair<uint64_t, V> a, uint64_t ha, pair<uint64_t, V> b, uint64_t hb, unsigned shift)
+    {
+        auto n = make_shared<Node>();
+        uint32_t ba = bit_at(ha, shift), bb = bit_at(hb, shift);
+        if (ba == bb)
+        {
+            n->nodemap = ba;
+            n->children.push_back(split(move(a), ha, move(b), hb, shift + 5));
+        }
+        else
+        {
+            n->datamap = ba | bb;
+            if (ba < bb) { n->data.push_back(move(a)); n->data.push_back(move(b)); }
+            else         { n->data.push_back(move(b)); n->data.push_back(move(a)); }
+        }
+        return n;
+    }
+
+    // returns true if the key was new
+    static bool insert(Node& n, uint64_t h, uint64_t key, V&& value, unsigned shift)
+    {
+        uint32_t bit = bit_at(h, shift);
+        if (n.datamap & bit)
+        {
+            auto i = index(n.datamap, bit);
+            if (n.data[i].first == key)
+            {
+                n.data[i].second = move(value);
+                return false;
+            }
+            // 2 keys in one slot, push both down into a new child node
+            auto existing = move(n.data[i]);
+            uint64_t existing_hash = hash(existing.first);
+            n.data.erase(n.data.begin() + i);
+            n.datamap ^= bit;
+            auto child = split(move(existing), existing_hash, { key, move(value) }, h, shift + 5);
+            n.nodemap |= bit;
+            n.children.insert(n.children.begin() + index(n.nodemap, bit), move(child));
+            return true;
+        }
+        if (n.nodemap & bit)
+        {
+            auto& child = n.children[index(n.nodemap, bit)];
+            return insert(own(child), h, key, move(value), shift + 5);
+        }
+        n.datamap |= bit;
+        n.data.insert(n.data.begin() + index(n.datamap, bit), { key, move(value) });
+        return true;
+    }
+
+public:
+    const V* find(uint64_t key) const
+    {
+        uint64_t h = hash(key);
+        const Node* n = root.get();
+        for (unsigned shift = 0;; shift += 5)
+        {
+            uint32_t bit = bit_at(h, shift);
+            if (n->datamap & bit)
+            {
+                auto& kv = n->data[index(n->datamap, bit)];
+                return kv.first == key ? &kv.second : nullptr;
+            }
+            if (!(n->nodemap & bit)) return nullptr;
+            n = n->children[index(n->nodemap, bit)].get();
+        }
+    }
+
+    void set(uint64_t key, V value)
+    {
+        if (insert(own(root), hash(key), key, move(value), 0))
+            ++count;
+    }
+
+    size_t size() const { return count; }
+};
@@ -0,0 +1,102 @@
+#include <iostream>
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+#include <malloc.h>
+#include "persistentmap.hpp"
+using namespace std;
+
+// A large state (a map with millions of entries) snapshotted by mementos.
+// The memento holds a PersistentMap, which shares every node with the live
+// state, so taking it and restoring it are both O(1).
+
+class Memento
+{
+    PersistentMap<int> entries;
+public:
+    explicit Memento(PersistentMap<int> entries) : entries(move(entries)) {}
+    friend class Ledger;
+};
+
+class Ledger
+{
+    PersistentMap<int> entries;
+public:
+    void set(uint64_t key, int value) { entries.set(key, value); }
+    const int* get(uint64_t key) const { return entries.find(key); }
+    size_t size() const { return entries.size(); }
+
+    Memento snapshot() const { return Memento{ entries }; }
+    void restore(const Memento& m) { entries = m.entries; }
+};
+
+static size_t heap_bytes()
+{
+    return mallinfo2().uordblks;
+}
+
+// Snapshot frequency against memory: starting from the same `n` entries,
+// make `updates` random changes keeping a memento every `every` updates.
+// usage: ./snapshots [entries] [updates]
+int main(int argc, char* argv[])
+{
+    const size_t n = argc > 1 ? stoul(argv[1]) : 10'000'000;
+    const size_t updates = argc > 2 ? stoul(argv[2]) : 1'000'000;
+    using clock = chrono::steady_clock;
+
+    size_t before = heap_bytes();
+    auto start = clock::now();
+    Ledger ledger;
+    for (size_t k = 0; k < n; ++k) ledger.set(k, static_cast<int>(k));
+    chrono::duration<double> built = clock::now() - start;
+    size_t base = heap_bytes() - before;
+    cout << n << " entries: built in " << built.count() << "s, "
+         << base / (1 << 20) << " MB (" << base / double(n) << " bytes/entry)\n";
+
+    // what a memento holding a plain copy would cost every single time
+    {
+        vector<pair<uint64_t, int>> flat(n);
+        start = clock::now();
+        auto copy = flat;
+        chrono::duration<double, milli> took = clock::now() - start;
+        cout << "deep copy of a flat " << n << " entry array: " << took.count() << " ms per snapshot\n\n";
+    }
+
+    cout << "snapshot every   snapshots   extra MB   ns/update   ns/snapshot\n";
+    for (size_t every : { 1, 10, 100, 1000, 10000 })
+    {
+        Ledger state = ledger;          // itself an O(1) copy
+        vector<Memento> history;
+        mt19937_64 rng{ every };
+
+        size_t mem_before = heap_bytes();
+        chrono::duration<double, nano> updating{}, snapshotting{};
+        for (size_t u = 1; u <= updates; ++u)
+        {
+            auto t = clock::now();
+            state.set(rng() % n, static_cast<int>(u));
+            auto t2 = clock::now();
+            updating += t2 - t;
+            if (u % every == 0)
+            {
+                history.push_back(state.snapshot());
+                snapshotting += clock::now() - t2;
+            }
+        }
+        size_t extra = heap_bytes() - mem_before;
+
+        // restoring any of them is a pointer copy too
+        if (!history.empty())
+        {
+            state.restore(history.front());
+            state.restore(history.back());
+        }
+
+        cout << "  " << every << "\t\t" << history.size() << "\t\t"
+             << extra / double(1 << 20) << "\t" << updating.count() / updates << "\t\t"
+             << (history.empty() ? 0 : snapshotting.count() / history.size()) << "\n";
+    }
+    return 0;
+}
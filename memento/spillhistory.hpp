@@ -0,0 +1,203 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <system_error>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+using namespace std;
+
+// Undo/redo history for an int state that never forgets, but only keeps the
+// most recent `hot_capacity` states in RAM.
+//
+// Older states are appended to segment files of `segment_size` states each
+// (state v lives in segment v / segment_size at record v % segment_size).
+// Undoing past the states in RAM maps the segment it needs read-only with
+// mmap, so the kernel pages in just what is read. Only one segment is mapped
+// at a time, resident memory stays the ring plus the pages of that segment
+// however long the session gets.
+class SpillHistory
+{
+    vector<int> hot;             // hot[v % capacity], versions [cold_count, last]
+    vector<int> spill_buffer;
+    size_t segment_size;
+    size_t cold_count = 0;       // versions [0, cold_count) are on disk
+    size_t current = 0;
+    size_t last = 0;
+    int state;
+
+    filesystem::path dir;
+    string prefix;
+    int write_fd = -1;
+    size_t write_segment = 0;
+
+    struct Mapping
+    {
+        size_t segment = 0;
+        const int* records = nullptr;
+        size_t count = 0;
+    } mapped;
+
+public:
+    explicit SpillHistory(int initial, size_t hot_capacity = 1024, size_t segment_size = 1 << 16,
+                          filesystem::path dir = filesystem::temp_directory_path())
+        : hot(max<size_t>(hot_capacity, 2)), segment_size(max<size_t>(segment_size, 1)), state(initial), dir(move(dir))
+    {
+        static atomic<unsigned> instances{ 0 };
+        prefix = "memento-" + to_string(getpid()) + "-" + to_string(instances++);
+        hot[0] = initial;
+    }
+
+    SpillHistory(const SpillHistory&) = delete;
+    SpillHistory& operator=(const SpillHistory&) = delete;
+
+    ~SpillHistory()
+    {
+        unmap();
+        if (write_fd >= 0) close(write_fd);
+        // a destructor can't throw: a file that won't go is left behind
+        error_code ignored;
+        if (cold_count > 0)
+            for (size_t k = 0; k <= (cold_count - 1) / segment_size; ++k)
+                filesystem::remove(segment_path(k), ignored);
+    }
+
+    // A new state after `current`, dropping anything that could be redone
+    void record(int new_state)
+    {
+        if (current < cold_count)
+            truncate_cold(current + 1);
+        last = current + 1;
+        if (last - cold_count + 1 > hot.size())
+            spill();
+
+        current = last;
+        hot[current % hot.size()] = new_state;
+        state = new_state;
+    }
+
+    optional<int> undo()
+    {
+        if (current == 0) return {};
+        state = read(--current);
+        return state;
+    }
+
+    optional<int> redo()
+    {
+        if (current == last) return {};
+        state = read(++current);
+        return state;
+    }
+
+    optional<int> at(size_t version)
+    {
+        if (version > last) return {};
+        return read(version);
+    }
+
+    size_t version() const { return current; }
+    size_t oldest_version() const { return 0; }
+    size_t newest_version() const { return last; }
+    size_t versions_on_disk() const { return cold_count; }
+
+private:
+    filesystem::path segment_path(size_t k) const
+    {
+        return dir / (prefix + "-" + to_string(k) + ".seg");
+    }
+
+    [[noreturn]] static void fail(const string& what)
+    {
+        throw system_error(errno, generic_category(), what);
+    }
+
+    int read(size_t v)
+    {
+        if (v >= cold_count) return hot[v % hot.size()];
+
+        size_t k = v / segment_size, i = v % segment_size;
+        if (!mapped.records || mapped.segment != k || i >= mapped.count)
+            map_segment(k);
+        return mapped.records[i];
+    }
+
+    void map_segment(size_t k)
+    {
+        unmap();
+        int fd = open(segment_path(k).c_str(), O_RDONLY);
+        if (fd < 0) fail("open " + segment_path(k).string());
+        struct stat st;
+        if (fstat(fd, &st) < 0)
+        {
+            int error = errno;
+            close(fd);
+            errno = error;
+            fail("stat " + segment_path(k).string());
+        }
+        void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED) fail("mmap " + segment_path(k).string());
+        mapped = { k, static_cast<const int*>(p), st.st_size / sizeof(int) };
+    }
+
+    void unmap()
+    {
+        if (mapped.records)
+            munmap(const_cast<int*>(mapped.records), mapped.count * sizeof(int));
+        mapped = {};
+    }
+
+    // moves the oldest half of the ring to disk, one write per segment touched
+    void spill()
+    {
+        size_t n = hot.size() / 2;
+        while (n > 0)
+        {
+            size_t v = cold_count, k = v / segment_size;
+            size_t run = min(n, segment_size - v % segment_size);
+            spill_buffer.resize(run);
+            for (size_t j = 0; j < run; ++j)
+                spill_buffer[j] = hot[(v + j) % hot.size()];
+
+            if (write_fd < 0 || write_segment != k)
+            {
+                if (write_fd >= 0) close(write_fd);
+                write_fd = open(segment_path(k).c_str(), O_WRONLY | O_CREAT, 0600);
+                if (write_fd < 0) fail("open " + segment_path(k).string());
+                write_segment = k;
+            }
+            auto bytes = run * sizeof(int);
+            if (pwrite(write_fd, spill_buffer.data(), bytes, (v % segment_size) * sizeof(int)) != ssize_t(bytes))
+                fail("write " + segment_path(k).string());
+
+            cold_count += run;
+            n -= run;
+        }
+    }
+
+    // keeps only versions [0, keep) on disk, the RAM ring is empty afterwards
+    void truncate_cold(size_t keep)
+    {
+        unmap();
+        size_t keep_segment = (keep - 1) / segment_size;
+        size_t last_segment = (cold_count - 1) / segment_size;
+        for (size_t k = keep_segment + 1; k <= last_segment; ++k)
+            filesystem::remove(segment_path(k));
+        if (write_fd >= 0 && write_segment != keep_segment)
+        {
+            close(write_fd);
+            write_fd = -1;
+        }
+        filesystem::resize_file(segment_path(keep_segment),
+                                ((keep - 1) % segment_size + 1) * sizeof(int));
+        cold_count = keep;
+    }
+};
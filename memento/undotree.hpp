@@ -0,0 +1,115 @@
+#pragma once
+#include <cstddef>
+#include <optional>
+#include <vector>
+using namespace std;
+
+// Undo history for an int state that is a tree instead of a line.
+//
+// Every recorded state is a node addressed by its id (0 is the initial state)
+// storing its parent and the delta from the parent's state. A change made
+// after an undo starts a new branch instead of throwing the redo states away.
+//
+// jump(id) goes to any node by undoing up to the closest common ancestor of
+// the current node and the target, then redoing down to the target: the
+// shortest path through the tree, never a replay from the root. Moving to a
+// sibling branch is 2 deltas however big the tree is.
+class UndoTree
+{
+    static constexpr size_t none = static_cast<size_t>(-1);
+
+    struct Node
+    {
+        size_t parent;
+        size_t depth;
+        int delta;                   // state - parent's state
+        size_t redo_child = none;    // branch redo() follows: the newest or last visited
+    };
+
+    vector<Node> nodes;
+    vector<size_t> path;             // scratch for jump()
+    size_t current = 0;
+    size_t applied = 0;
+    int state;
+
+public:
+    explicit UndoTree(int initial) : state(initial)
+    {
+        nodes.push_back({ none, 0, 0 });
+    }
+
+    void record(int new_state)
+    {
+        size_t id = nodes.size();
+        nodes.push_back({ current, nodes[current].depth + 1, new_state - state });
+        nodes[current].redo_child = id;
+        current = id;
+        state = new_state;
+        applied = 0;
+    }
+
+    optional<int> undo()
+    {
+        applied = 0;
+        if (current == 0) return {};
+        state -= nodes[current].delta;
+        current = nodes[current].parent;
+        applied = 1;
+        return state;
+    }
+
+    optional<int> redo()
+    {
+        applied = 0;
+        size_t child = nodes[current].redo_child;
+        if (child == none) return {};
+        current = child;
+        state += nodes[current].delta;
+        applied = 1;
+        return state;
+    }
+
+    optional<int> jump(size_t id)
+    {
+        applied = 0;
+        if (id >= nodes.size()) return {};
+
+        // climb from the deeper side first, then both together until they meet
+        size_t up = current, down = id;
+        path.clear();
+        while (nodes[down].depth > nodes[up].depth)
+        {
+            path.push_back(down);
+            down = nodes[down].parent;
+        }
+        while (nodes[up].depth > nodes[down].depth)
+        {
+            state -= nodes[up].delta;
+            up = nodes[up].parent;
+            ++applied;
+        }
+        while (up != down)
+        {
+            state -= nodes[up].delta;
+            up = nodes[up].parent;
+            ++applied;
+            path.push_back(down);
+            down = nodes[down].parent;
+        }
+
+        // back down to the target, redo() follows this branch from now on
+        for (auto it = path.rbegin(); it != path.rend(); ++it)
+        {
+            nodes[nodes[*it].parent].redo_child = *it;
+            state += nodes[*it].delta;
+            ++applied;
+        }
+        current = id;
+        return state;
+    }
+
+    size_t version() const { return current; }
+    size_t size() const { return nodes.size(); }
+    // how many deltas the last undo/redo/jump applied
+    size_t deltas_applied() const { return applied; }
+};
@@ -0,0 +1,81 @@
+#pragma once
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+using namespace std;
+
+struct Image
+{
+    virtual ~Image() = default;
+    virtual void draw() = 0;
+};
+
+// The real thing: the image file, mapped into memory. The pages come from
+// the page cache, there is no copy on the heap, and many images can be
+// mapped at once. They are faulted in by the constructor (MAP_POPULATE), so
+// the file is read where the Bitmap is loaded, on BitmapCache's I/O thread
+// for a prefetch, not on first touch in whoever draws it. Where the file
+// can't be mapped (a pipe, an empty file) it is read into memory instead.
+struct Bitmap : Image
+{
+    Bitmap(const string& filename) : filename(filename)
+    {
+        cout << "Loading image from " << filename << endl;
+        if (!map()) read();
+    }
+
+    Bitmap(const Bitmap&) = delete;
+    Bitmap& operator=(const Bitmap&) = delete;
+
+    ~Bitmap()
+    {
+        if (mapped) munmap(mapped, bytes);
+    }
+
+    void draw() override
+    {
+        cout << "Drawing image " << filename << " (" << bytes << " bytes" << (mapped ? ", mapped" : "") << ")" << endl;
+    }
+
+    const char* data() const { return mapped ? static_cast<const char*>(mapped) : pixels.data(); }
+    size_t size() const { return bytes; }
+
+private:
+    bool map()
+    {
+        int fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+        {
+            void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+            if (p != MAP_FAILED)
+            {
+                mapped = p;
+                bytes = st.st_size;
+            }
+        }
+        close(fd);    // the mapping stays
+        return mapped;
+    }
+
+    void read()
+    {
+        ifstream in{ filename, ios::binary };
+        if (!in) throw runtime_error("can't open " + filename);
+        pixels.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+        bytes = pixels.size();
+    }
+
+    string filename;
+    void* mapped = nullptr;
+    size_t bytes = 0;
+    vector<char> pixels;
+};
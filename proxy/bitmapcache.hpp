@@ -0,0 +1,174 @@
+#pragma once
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "bitmap.hpp"
+using namespace std;
+
+// Loaded bitmaps by file name, for the proxies to draw from.
+//
+// prefetch() is a hint that an image will be drawn soon: it is loaded on one
+// of the cache's I/O threads, so by the time it is drawn get() just returns
+// it. get() of an image still loading waits for that load; of one never
+// asked for, loads it right there (the old behaviour).
+//
+// Loaded bitmaps are kept in LRU order, and the least recently used are
+// dropped once they take more than `budget` bytes. Someone still drawing a
+// dropped bitmap keeps it alive through its shared_ptr.
+class BitmapCache
+{
+public:
+    struct Stats
+    {
+        uint64_t hits = 0;          // already loaded
+        uint64_t waited = 0;        // had to wait for a prefetch still loading
+        uint64_t misses = 0;        // loaded by get() itself
+        uint64_t prefetched = 0, evicted = 0;
+        size_t bytes = 0, bitmaps = 0;
+    };
+
+private:
+    struct Entry
+    {
+        shared_future<shared_ptr<Bitmap>> bitmap;
+        list<string>::iterator lru;             // valid once loaded
+        bool loaded = false;
+    };
+
+    size_t budget;
+    mutex lock;
+    condition_variable work;
+    unordered_map<string, Entry> entries;
+    list<string> lru;                           // loaded, most recently used first
+    size_t bytes = 0;
+    deque<pair<string, promise<shared_ptr<Bitmap>>>> queue;
+    bool stopping = false;
+    Stats counts;
+    vector<thread> io;
+
+public:
+    explicit BitmapCache(size_t budget, size_t io_threads = 2) : budget(budget)
+    {
+        for (size_t i = 0; i < max<size_t>(io_threads, 1); ++i)
+            io.emplace_back([this] { load_queued(); });
+    }
+
+    // prefetches not started yet are dropped, anyone waiting for them gets
+    // a broken_promise
+    ~BitmapCache()
+    {
+        {
+            lock_guard l{ lock };
+            stopping = true;
+        }
+        work.notify_all();
+        for (auto& t : io) t.join();
+    }
+
+    void prefetch(const string& filename)
+    {
+        lock_guard l{ lock };
+        if (entries.count(filename)) return;
+        promise<shared_ptr<Bitmap>> loaded;
+        entries[filename].bitmap = loaded.get_future().share();
+        queue.emplace_back(filename, move(loaded));
+        ++counts.prefetched;
+        work.notify_one();
+    }
+
+    // throws what Bitmap's constructor threw if the image can't be loaded
+    shared_ptr<Bitmap> get(const string& filename)
+    {
+        unique_lock l{ lock };
+        auto it = entries.find(filename);
+        if (it != entries.end())
+        {
+            auto& e = it->second;
+            if (e.loaded)
+            {
+                ++counts.hits;
+                lru.splice(lru.begin(), lru, e.lru);
+                return e.bitmap.get();
+            }
+            ++counts.waited;
+            auto loading = e.bitmap;
+            l.unlock();
+            return loading.get();
+        }
+
+        ++counts.misses;
+        promise<shared_ptr<Bitmap>> loaded;
+        auto bitmap = loaded.get_future().share();
+        entries[filename].bitmap = bitmap;
+        l.unlock();
+        load(filename, move(loaded));
+        return bitmap.get();
+    }
+
+    Stats stats()
+    {
+        lock_guard l{ lock };
+        Stats s = counts;
+        s.bytes = bytes;
+        s.bitmaps = lru.size();
+        return s;
+    }
+
+private:
+    void load_queued()
+    {
+        for (;;)
+        {
+            unique_lock l{ lock };
+            work.wait(l, [this] { return stopping || !queue.empty(); });
+            if (stopping) return;
+            auto [filename, loaded] = move(queue.front());
+            queue.pop_front();
+            l.unlock();
+            load(filename, move(loaded));
+        }
+    }
+
+    void load(const string& filename, promise<shared_ptr<Bitmap>> loaded)
+    {
+        shared_ptr<Bitmap> bitmap;
+        try
+        {
+            bitmap = make_shared<Bitmap>(filename);
+        }
+        catch (...)
+        {
+            // not cached, the next get() tries again
+            loaded.set_exception(current_exception());
+            lock_guard l{ lock };
+            entries.erase(filename);
+            return;
+        }
+        loaded.set_value(bitmap);
+
+        lock_guard l{ lock };
+        auto& e = entries.at(filename);
+        e.loaded = true;
+        lru.push_front(filename);
+        e.lru = lru.begin();
+        bytes += bitmap->size();
+        while (bytes > budget && !lru.empty())
+        {
+            auto last = entries.find(lru.back());
+            bytes -= last->second.bitmap.get()->size();
+            entries.erase(last);
+            lru.pop_back();
+            ++counts.evicted;
+        }
+    }
+};
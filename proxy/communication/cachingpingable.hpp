@@ -0,0 +1,200 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "pingable.hpp"
+using namespace std;
+
+// A Pingable in front of another one (a RemotePong, or anything else) for
+// idempotent messages: the answer to a message is kept for `ttl`, and asking
+// again meanwhile doesn't go upstream.
+//
+// Messages are spread over shards by hash, each with its own lock, map and
+// LRU list, so threads asking for different messages rarely meet. A shard
+// holds at most capacity / shards answers; past that the least recently
+// used goes.
+//
+// A miss stores a task for the answer, then asks upstream without the lock
+// held: anyone asking for the same message meanwhile gets that task too, so
+// concurrent misses are one upstream request (single-flight). A failed
+// request isn't cached, the next ping tries again.
+class CachingPingable : public Pingable
+{
+    using clock_type = chrono::steady_clock;
+
+    struct Slot
+    {
+        pplx::task<wstring> answer;
+        clock_type::time_point expires;
+        list<wstring>::iterator lru;        // valid once ready
+        bool ready = false;
+    };
+
+    struct Shard
+    {
+        mutex lock;
+        unordered_map<wstring, Slot> slots;
+        list<wstring> lru;                  // ready answers, most recently used first
+        uint64_t hits = 0, coalesced = 0, misses = 0, expired = 0, evicted = 0;
+    };
+
+    Pingable& upstream;
+    clock_type::duration ttl;
+    size_t shard_capacity;
+    vector<Shard> shards;
+    // Requests still upstream. Shared with their continuations: the last one
+    // still notifies it after the destructor, woken by its decrement, is gone.
+    shared_ptr<atomic<size_t>> in_flight = make_shared<atomic<size_t>>(0);
+
+public:
+    struct Stats
+    {
+        uint64_t requests = 0;
+        uint64_t hits = 0;          // answered from the cache
+        uint64_t coalesced = 0;     // joined a request already upstream
+        uint64_t upstream = 0;      // sent upstream
+        uint64_t expired = 0, evicted = 0;
+        size_t cached = 0;
+
+        double hit_ratio() const { return requests ? double(hits + coalesced) / requests : 0; }
+
+        // the share of requests that didn't reach upstream: its QPS is
+        // (1 - this) times ours
+        double upstream_reduction() const { return requests ? 1 - double(upstream) / requests : 0; }
+
+        friend ostream& operator<<(ostream& os, const Stats& s)
+        {
+            return os << s.requests << " requests, " << s.hits << " hits, " << s.coalesced << " coalesced, "
+                      << s.upstream << " upstream (hit ratio " << s.hit_ratio() * 100
+                      << "%, upstream QPS -" << s.upstream_reduction() * 100 << "%), " << s.expired
+                      << " expired, " << s.evicted << " evicted, " << s.cached << " cached";
+        }
+    };
+
+    CachingPingable(Pingable& upstream, chrono::milliseconds ttl, size_t capacity = 10'000, size_t shards = 16)
+        : upstream(upstream), ttl(ttl), shard_capacity(max<size_t>(capacity / max<size_t>(shards, 1), 1)),
+          shards(max<size_t>(shards, 1))
+    {
+    }
+
+    // waits for the requests still upstream, their continuations use `this`
+    ~CachingPingable()
+    {
+        for (size_t n = in_flight->load(); n; n = in_flight->load())
+            in_flight->wait(n);
+    }
+
+    pplx::task<wstring> ping_async(const wstring& message) override
+    {
+        auto& shard = shards[hash<wstring>{}(message) % shards.size()];
+        unique_lock l{ shard.lock };
+        auto now = clock_type::now();
+        auto [it, inserted] = shard.slots.try_emplace(message);
+        auto& slot = it->second;
+        if (!inserted)
+        {
+            if (!slot.ready)
+            {
+                ++shard.coalesced;
+                return slot.answer;
+            }
+            if (slot.expires > now)
+            {
+                ++shard.hits;
+                shard.lru.splice(shard.lru.begin(), shard.lru, slot.lru);
+                return slot.answer;
+            }
+            ++shard.expired;
+            shard.lru.erase(slot.lru);
+            slot.ready = false;
+        }
+
+        ++shard.misses;
+        pplx::task_completion_event<wstring> result;
+        slot.answer = pplx::create_task(result);
+        auto answer = slot.answer;
+        in_flight->fetch_add(1);
+        l.unlock();
+
+        pplx::task<wstring> request;
+        try
+        {
+            request = upstream.ping_async(message);
+        }
+        catch (...)
+        {
+            request = pplx::task_from_exception<wstring>(current_exception());
+        }
+        request.then([this, &shard, message, result, pending = in_flight](pplx::task<wstring> upstream_answer) {
+            // `this` and `shard` only until the decrement below
+            try
+            {
+                auto value = upstream_answer.get();
+                {
+                    lock_guard l{ shard.lock };
+                    auto& slot = shard.slots.at(message);
+                    slot.ready = true;
+                    slot.expires = clock_type::now() + ttl;
+                    shard.lru.push_front(message);
+                    slot.lru = shard.lru.begin();
+                    evict(shard);
+                }
+                result.set(move(value));
+            }
+            catch (...)
+            {
+                {
+                    lock_guard l{ shard.lock };
+                    shard.slots.erase(message);
+                }
+                result.set_exception(current_exception());
+            }
+            pending->fetch_sub(1);
+            pending->notify_all();
+        });
+        return answer;
+    }
+
+    wstring ping(const wstring& message) override
+    {
+        return ping_async(message).get();
+    }
+
+    Stats stats()
+    {
+        Stats s;
+        for (auto& shard : shards)
+        {
+            lock_guard l{ shard.lock };
+            s.hits += shard.hits;
+            s.coalesced += shard.coalesced;
+            s.upstream += shard.misses;
+            s.expired += shard.expired;
+            s.evicted += shard.evicted;
+            s.cached += shard.lru.size();
+        }
+        s.requests = s.hits + s.coalesced + s.upstream;
+        return s;
+    }
+
+private:
+    // with the shard's lock held
+    void evict(Shard& shard)
+    {
+        while (shard.lru.size() > shard_capacity)
+        {
+            shard.slots.erase(shard.lru.back());
+            shard.lru.pop_back();
+            ++shard.evicted;
+        }
+    }
+};
@@ -0,0 +1,86 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+using namespace std;
+
+// Latency histogram in the style of HdrHistogram: values up to 128 are
+// counted exactly, above that every power of two is split into 64 buckets,
+// so a value is off by less than 1.6% whatever its size. Recording is one
+// relaxed atomic increment, any number of threads can record at once while
+// another reads the percentiles.
+//
+// Values are whatever unit the caller picks (pong records nanoseconds).
+class LatencyHistogram
+{
+    static constexpr unsigned sub_bits = 6;                  // 64 buckets per power of two
+    static constexpr uint64_t exact = uint64_t(1) << (sub_bits + 1);
+    static constexpr size_t bucket_count = (64 - sub_bits + 1) << sub_bits;
+
+    array<atomic<uint64_t>, bucket_count> counts{};
+    atomic<uint64_t> total{ 0 }, sum{ 0 }, largest{ 0 };
+
+public:
+    void record(uint64_t value)
+    {
+        counts[index(value)].fetch_add(1, memory_order_relaxed);
+        total.fetch_add(1, memory_order_relaxed);
+        sum.fetch_add(value, memory_order_relaxed);
+        uint64_t seen = largest.load(memory_order_relaxed);
+        while (value > seen && !largest.compare_exchange_weak(seen, value, memory_order_relaxed))
+            ;
+    }
+
+    uint64_t count() const { return total.load(memory_order_relaxed); }
+    uint64_t max() const { return largest.load(memory_order_relaxed); }
+
+    double mean() const
+    {
+        auto n = count();
+        return n ? double(sum.load(memory_order_relaxed)) / n : 0;
+    }
+
+    // the value `p` percent of the recordings are at or below (the top of
+    // its bucket, never more than the largest value recorded)
+    uint64_t percentile(double p) const
+    {
+        uint64_t n = count();
+        if (n == 0) return 0;
+        uint64_t rank = std::max<uint64_t>(1, uint64_t(p / 100 * n + 0.5));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < bucket_count; ++i)
+        {
+            seen += counts[i].load(memory_order_relaxed);
+            if (seen >= rank) return std::min(highest_in(i), max());
+        }
+        return max();
+    }
+
+    // not atomic as a whole: recordings racing with it may be half kept
+    void reset()
+    {
+        for (auto& c : counts) c.store(0, memory_order_relaxed);
+        total.store(0, memory_order_relaxed);
+        sum.store(0, memory_order_relaxed);
+        largest.store(0, memory_order_relaxed);
+    }
+
+private:
+    static size_t index(uint64_t v)
+    {
+        if (v < exact) return size_t(v);
+        // keep the top sub_bits + 1 bits: v >> shift is in [64, 128)
+        unsigned shift = unsigned(bit_width(v)) - (sub_bits + 1);
+        return (size_t(shift) << sub_bits) + size_t(v >> shift);
+    }
+
+    static uint64_t highest_in(size_t i)
+    {
+        if (i < exact) return i;
+        unsigned shift = unsigned(i >> sub_bits) - 1;
+        uint64_t low = uint64_t((i & (exact / 2 - 1)) + exact / 2) << shift;
+        return low + ((uint64_t(1) << shift) - 1);
+    }
+};
@@ -1,71 +1,171 @@
 /*****************
  *  Ping Client  *
  *****************/
+#include <algorithm>
+#include <cctype>
+#include <chrono>
 #include <string>
 #include <iostream>
 #include <sstream>
 #include <memory>
-#include <cpprest/http_client.h>
-#include <cpprest/filestream.h>
-using namespace utility;                    // Common utilities like string conversions
-using namespace web;                        // Common features like URIs.
-using namespace web::http;                  // Common HTTP functionality
-using namespace web::http::client;          // HTTP client features
-using namespace concurrency::streams;       // Asynchronous streams
+#include <optional>
+#include <vector>
+#include "pingable.hpp"
+#include "remotepong.hpp"
+#include "cachingpingable.hpp"
 
-using namespace std;
-
-
-struct Pingable
+void tryit(Pingable& pp)
 {
-    virtual ~Pingable() = default;
-    virtual wstring ping(const wstring& message) = 0;
-};
+    wcout << L"Ping" << ' ' << pp.ping(L"ping") << "\n";
+}
 
-struct Pong : Pingable
+using clock_type = chrono::steady_clock;
+
+// the server's own time for what was sent since the last call, from pong's
+// /stats (which is then reset); nothing from a server without it, like rawpong
+static optional<string> server_time(const utility::string_t& server)
 {
-    wstring ping(const wstring& message) override
+    try
     {
-        return message + L" pong";
+        auto stats = http_client{ server }
+                         .request(methods::GET, U("/stats?reset"))
+                         .then([](http_response r) { return r.extract_json(); })
+                         .get();
+        auto endpoint = stats[U("batch")][U("count")].as_double() > 0 ? stats[U("batch")] : stats[U("ping")];
+        ostringstream out;
+        out << "server us p50 " << endpoint[U("p50_us")].as_double() << ", p99 " << endpoint[U("p99_us")].as_double();
+        return out.str();
     }
-};
-
-
-struct RemotePong : Pingable
-{
-    wstring ping(const wstring& message) override
+    catch (const exception&)
     {
-        wstring result;
-        http_client client(U("http://localhost:9149/"));
-        uri_builder builder(U("/api/pingpong/"));
-
-        // Append the message as a query parameter
-        builder.append_query(U("message"), "Ping");
-        
-        return client.request(methods::GET, builder.to_string())
-            .then([](http_response r) {
-                return r.extract_string();
-            })
-            .then([](const std::string& str) {
-                return wstring(str.begin(), str.end());
-            })
-            .get();
+        return nullopt;
     }
-};
+}
 
-void tryit(Pingable& pp)
+// "9150" is a server on that port of this host, anything else a URL
+static utility::string_t server_from(const string& arg)
 {
-    wcout << L"Ping" << ' ' << pp.ping(L"ping") << "\n";
+    if (!arg.empty() && all_of(arg.begin(), arg.end(), ::isdigit))
+        return U("http://localhost:") + arg + U("/");
+    return arg;
 }
 
+static void report(const string& name, vector<double>& latencies, double seconds,
+                   const utility::string_t& server)
+{
+    sort(latencies.begin(), latencies.end());
+    auto pct = [&](double p) { return latencies[min(latencies.size() - 1, size_t(p / 100 * latencies.size()))]; };
+    cout << name << ": " << latencies.size() / seconds << " pings/s, latency us p50 "
+         << pct(50) << ", p99 " << pct(99) << ", max " << latencies.back() << "\n";
+    if (auto server_side = server_time(server)) cout << "    (" << *server_side << ")\n";
+}
 
-int main()
+// usage: ./ping [pings] [connections] [in flight] [server URL or port]
+int main(int argc, char* argv[])
 {
-    RemotePong pp;
+    const size_t pings = argc > 1 ? stoul(argv[1]) : 0;
+    const size_t connections = argc > 2 ? stoul(argv[2]) : 4;
+    const ptrdiff_t window = argc > 3 ? stol(argv[3]) : 64;
+    const auto server = server_from(argc > 4 ? argv[4] : "9149");
+
+    RemotePong pp{ server, connections, window };
     for (int i = 0; i < 3; ++i)
     {
         tryit(pp);
     }
+
+    // the callback flavour, same for a local Pong or a proxy
+    Pong local;
+    local.ping_then(L"ping", [](wstring answer, exception_ptr) { wcout << L"Local " << answer << "\n"; });
+    if (pings == 0) return 0;
+    // only ./pong has /stats and the batch endpoint
+    const bool full_pong = server_time(server).has_value();
+
+    // one connection per ping, one at a time
+    {
+        OneShotRemotePong one_shot{ server };
+        vector<double> latencies;
+        auto start = clock_type::now();
+        for (size_t i = 0; i < pings; ++i)
+        {
+            auto t = clock_type::now();
+            one_shot.ping(L"ping");
+            latencies.push_back(chrono::duration<double, micro>(clock_type::now() - t).count());
+        }
+        report("new connection per ping", latencies,
+               chrono::duration<double>(clock_type::now() - start).count(), server);
+    }
+
+    // pooled, still one at a time
+    {
+        vector<double> latencies;
+        auto start = clock_type::now();
+        for (size_t i = 0; i < pings; ++i)
+        {
+            auto t = clock_type::now();
+            pp.ping(L"ping");
+            latencies.push_back(chrono::duration<double, micro>(clock_type::now() - t).count());
+        }
+        report("pooled, sequential", latencies,
+               chrono::duration<double>(clock_type::now() - start).count(), server);
+    }
+
+    // everything sent at once through the batching proxy
+    if (full_pong)
+    {
+        BatchingRemotePong batching{ server, connections };
+        vector<double> latencies(pings);
+        vector<pplx::task<void>> done;
+        done.reserve(pings);
+        auto start = clock_type::now();
+        for (size_t i = 0; i < pings; ++i)
+        {
+            auto t = clock_type::now();
+            done.push_back(batching.ping_async(L"ping").then([&latencies, i, t](wstring) {
+                latencies[i] = chrono::duration<double, micro>(clock_type::now() - t).count();
+            }));
+        }
+        pplx::when_all(done.begin(), done.end()).wait();
+        report("batched, " + to_string(size_t(batching.average_batch())) + " pings per request", latencies,
+               chrono::duration<double>(clock_type::now() - start).count(), server);
+    }
+
+    // pooled, `window` pings outstanding
+    {
+        vector<double> latencies(pings);
+        vector<pplx::task<void>> done;
+        done.reserve(pings);
+        auto start = clock_type::now();
+        for (size_t i = 0; i < pings; ++i)
+        {
+            auto t = clock_type::now();
+            done.push_back(pp.ping_async(L"ping").then([&latencies, i, t](wstring) {
+                latencies[i] = chrono::duration<double, micro>(clock_type::now() - t).count();
+            }));
+        }
+        pplx::when_all(done.begin(), done.end()).wait();
+        report("pooled, " + to_string(window) + " in flight", latencies,
+               chrono::duration<double>(clock_type::now() - start).count(), server);
+    }
+
+    // the same through a cache, asking 100 different messages over and over
+    {
+        CachingPingable cached{ pp, chrono::seconds(1) };
+        vector<double> latencies(pings);
+        vector<pplx::task<void>> done;
+        done.reserve(pings);
+        auto start = clock_type::now();
+        for (size_t i = 0; i < pings; ++i)
+        {
+            auto t = clock_type::now();
+            done.push_back(cached.ping_async(L"ping " + to_wstring(i % 100)).then([&latencies, i, t](wstring) {
+                latencies[i] = chrono::duration<double, micro>(clock_type::now() - t).count();
+            }));
+        }
+        pplx::when_all(done.begin(), done.end()).wait();
+        report("cached, 100 messages", latencies,
+               chrono::duration<double>(clock_type::now() - start).count(), server);
+        cout << "    " << cached.stats() << "\n";
+    }
     return 0;
 }
-
@@ -0,0 +1,49 @@
+#pragma once
+#include <exception>
+#include <functional>
+#include <string>
+#include <utility>
+#include <pplx/pplxtasks.h>
+using namespace std;
+
+struct Pingable
+{
+    virtual ~Pingable() = default;
+    virtual wstring ping(const wstring& message) = 0;
+
+    // The answer later. By default ping() runs on the pplx thread pool;
+    // remote proxies override it to send without waiting.
+    virtual pplx::task<wstring> ping_async(const wstring& message)
+    {
+        return pplx::create_task([this, message] { return ping(message); });
+    }
+
+    // Calls `done` with the answer, or with an error, when it arrives.
+    using Completion = function<void(wstring answer, exception_ptr error)>;
+    void ping_then(const wstring& message, Completion done)
+    {
+        ping_async(message).then([done = move(done)](pplx::task<wstring> answer) {
+            try
+            {
+                done(answer.get(), nullptr);
+            }
+            catch (...)
+            {
+                done({}, current_exception());
+            }
+        });
+    }
+};
+
+struct Pong : Pingable
+{
+    wstring ping(const wstring& message) override
+    {
+        return message + L" pong";
+    }
+
+    pplx::task<wstring> ping_async(const wstring& message) override
+    {
+        return pplx::task_from_result(ping(message));
+    }
+};
@@ -1,11 +1,15 @@
 /******************
  * Pong Webserver *
  ******************/
+#include <chrono>
 #include <iostream>
 #include <string>
+#include <thread>
 #include <cpprest/http_listener.h>
 #include <cpprest/json.h>
 #include <cpprest/filestream.h>
+#include <pplx/threadpool.h>
+#include "histogram.hpp"
 
 using namespace web;
 using namespace web::http;
@@ -26,8 +30,55 @@ struct BasicPong : Pongable {
     }
 };
 
+// Service time of every request, from the handler being called to the
+// reply being handed back to the listener, in nanoseconds. Network time is
+// what the client measures minus this.
+struct ServerStats {
+    LatencyHistogram get, batch;
+} stats;
+
+using clock_type = chrono::steady_clock;
+
+void record(LatencyHistogram& histogram, clock_type::time_point start) {
+    histogram.record(chrono::duration_cast<chrono::nanoseconds>(clock_type::now() - start).count());
+}
+
+json::value to_json(const LatencyHistogram& histogram) {
+    auto us = [](uint64_t ns) { return json::value::number(ns / 1000.0); };
+    json::value v;
+    v[U("count")] = json::value::number(histogram.count());
+    v[U("mean_us")] = json::value::number(histogram.mean() / 1000.0);
+    v[U("p50_us")] = us(histogram.percentile(50));
+    v[U("p90_us")] = us(histogram.percentile(90));
+    v[U("p99_us")] = us(histogram.percentile(99));
+    v[U("p99.9_us")] = us(histogram.percentile(99.9));
+    v[U("max_us")] = us(histogram.max());
+    return v;
+}
+
+// GET /stats: service time percentiles per endpoint, /stats?reset starts over
+void handle_stats(http_request request) {
+    json::value v;
+    v[U("ping")] = to_json(stats.get);
+    v[U("batch")] = to_json(stats.batch);
+    if (request.request_uri().query() == U("reset")) {
+        stats.get.reset();
+        stats.batch.reset();
+    }
+    request.reply(status_codes::OK, v);
+}
+
+// What a ping is answered with, for GET and for every message of a batch
+const utf8string answer = "Pong";
+
 // Function to handle HTTP GET requests
 void handle_get(http_request request) {
+    if (request.relative_uri().path() == U("/stats")) {
+        handle_stats(request);
+        return;
+    }
+    auto start = clock_type::now();
+
     // Extract the message from the query string (if any)
     auto message = request.request_uri().query();
     //.at(U("message"));
@@ -39,14 +90,43 @@ void handle_get(http_request request) {
     //   json::value json_response;
     //   json_response[U("message")] = response;
 
-    utf8string resp = "Pong";
-        
+    // Send the response with status code 200 (OK)
+    request.reply(status_codes::OK, answer);
+    record(stats.get, start);
+}
 
-    // Send the JSON response with status code 200 (OK)
-    request.reply(status_codes::OK, resp);
+// Function to handle HTTP POST requests: /api/pingpong/batch takes a JSON
+// array of messages and answers with an array of what GET answers, one for
+// each message, so a batched ping gets the same answer as a single one
+void handle_post(http_request request) {
+    if (request.relative_uri().path() != U("/api/pingpong/batch")) {
+        request.reply(status_codes::NotFound);
+        return;
+    }
+    auto start = clock_type::now();
+    request.extract_json().then([request, start](pplx::task<json::value> body) {
+        try {
+            auto messages = body.get();
+            auto& list = messages.as_array();
+            auto answers = json::value::array(list.size());
+            for (size_t i = 0; i < list.size(); ++i)
+                answers[i] = json::value::string(answer);
+            request.reply(status_codes::OK, answers);
+            record(stats.batch, start);
+        }
+        catch (const exception&) {
+            request.reply(status_codes::BadRequest);
+        }
+    });
 }
 
-int main() {
+// usage: ./pong [threads]
+int main(int argc, char* argv[]) {
+    // Handlers run on cpprest's thread pool; it has to be sized before the
+    // first listener or client uses it
+    const size_t threads = argc > 1 ? stoul(argv[1]) : max(thread::hardware_concurrency(), 1u);
+    crossplat::threadpool::initialize_with_threads(threads);
+
     // Create an instance of the Pong implementation
     BasicPong pong;
 
@@ -61,10 +141,13 @@ int main() {
     // Register the GET request handler
     listener.support(methods::GET, handle_get);
 
+    // and the batch handler
+    listener.support(methods::POST, handle_post);
+
     // Start listening for requests
     listener.open().wait();
     std::wcout << L"Listening for requests on ";
-    cout  << webserver << std::endl;
+    cout  << webserver << " with " << threads << " threads, stats at /stats" << std::endl;
 
     // Wait for a user to press Enter to stop the server
     std::getchar();
@@ -0,0 +1,290 @@
+/**********************
+ * Raw Pong Webserver *
+ **********************/
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+using namespace std;
+
+// The same answer as ./pong to a GET, without cpprest: the baseline for
+// what the HTTP stack costs.
+//
+// Every thread has its own listening socket on the port (SO_REUSEPORT, the
+// kernel spreads new connections over them) and its own epoll, so threads
+// share nothing. Requests are parsed where they were read, just enough to
+// find where each ends: request line, Content-Length, Connection: close.
+// Every GET gets the same preformatted response, written straight from a
+// static buffer; pipelined requests become one writev of several copies.
+// Anything else gets a 405 and the connection is closed after it.
+//
+// usage: ./rawpong [port] [threads]
+
+namespace
+{
+    constexpr string_view pong =
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Type: text/plain; charset=utf-8\r\n"
+        "Content-Length: 4\r\n"
+        "\r\n"
+        "Pong";
+    constexpr string_view pong_and_close =
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Type: text/plain; charset=utf-8\r\n"
+        "Content-Length: 4\r\n"
+        "Connection: close\r\n"
+        "\r\n"
+        "Pong";
+    constexpr string_view not_allowed =
+        "HTTP/1.1 405 Method Not Allowed\r\n"
+        "Content-Length: 0\r\n"
+        "Connection: close\r\n"
+        "\r\n";
+    constexpr string_view too_large =
+        "HTTP/1.1 431 Request Header Fields Too Large\r\n"
+        "Content-Length: 0\r\n"
+        "Connection: close\r\n"
+        "\r\n";
+
+    constexpr size_t max_request = 8192;     // headers plus body
+    constexpr size_t iov_batch = 64;
+
+    struct Connection
+    {
+        int fd;
+        size_t have = 0;                     // bytes in `in`
+        uint64_t owed = 0;                   // `pong`s still to write
+        string_view last;                    // written after them, then the connection closes
+        size_t out_offset = 0;               // bytes of the first response already written
+        bool reading = true;                 // false once `last` is set or the client is done
+        char in[max_request];
+    };
+
+    [[noreturn]] void die(const string& what)
+    {
+        cerr << what << ": " << strerror(errno) << "\n";
+        exit(1);
+    }
+
+    int listen_on(uint16_t port)
+    {
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof one);
+        if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof one) < 0) die("SO_REUSEPORT");
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        addr.sin_port = htons(port);
+        if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof addr) < 0) die("bind");
+        if (listen(fd, SOMAXCONN) < 0) die("listen");
+        return fd;
+    }
+
+    bool iequals(string_view a, string_view b)
+    {
+        return a.size() == b.size() && equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+                   return tolower(static_cast<unsigned char>(x)) == tolower(static_cast<unsigned char>(y));
+               });
+    }
+
+    string_view trim(string_view s)
+    {
+        while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) s.remove_prefix(1);
+        while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) s.remove_suffix(1);
+        return s;
+    }
+
+    // Takes the complete requests at the front of c.in and counts what they
+    // are owed. Returns the bytes used, what is left is an incomplete request.
+    size_t parse(Connection& c)
+    {
+        size_t used = 0;
+        while (c.reading)
+        {
+            string_view rest{ c.in + used, c.have - used };
+            size_t end = rest.find("\r\n\r\n");
+            if (end == string_view::npos)
+            {
+                if (used == 0 && c.have == max_request)
+                {
+                    c.last = too_large;
+                    c.reading = false;
+                }
+                break;
+            }
+            string_view head = rest.substr(0, end + 2);
+
+            size_t body = 0;
+            bool close = false;
+            for (size_t line = head.find("\r\n") + 2; line < head.size();)
+            {
+                size_t eol = head.find("\r\n", line);
+                string_view header = head.substr(line, eol - line);
+                line = eol + 2;
+                size_t colon = header.find(':');
+                if (colon == string_view::npos) continue;
+                auto name = header.substr(0, colon);
+                auto value = trim(header.substr(colon + 1));
+                if (iequals(name, "content-length"))
+                    from_chars(value.data(), value.data() + value.size(), body);
+                else if (iequals(name, "connection") && iequals(value, "close"))
+                    close = true;
+            }
+            if (end + 4 + body > rest.size())
+            {
+                if (end + 4 + body > max_request)
+                {
+                    c.last = too_large;
+                    c.reading = false;
+                }
+                break;                       // the body isn't all here yet
+            }
+            used += end + 4 + body;
+
+            if (head.substr(0, 4) != "GET ")
+                c.last = not_allowed;
+            else if (close)
+                c.last = pong_and_close;
+            else
+                ++c.owed;
+            c.reading = c.last.empty();
+        }
+        return used;
+    }
+
+    // false when the connection is finished with
+    bool flush(Connection& c)
+    {
+        static thread_local iovec iov[iov_batch + 1];
+        while (c.owed || !c.last.empty())
+        {
+            size_t n = 0;
+            for (; n < iov_batch && n < c.owed; ++n)
+                iov[n] = { const_cast<char*>(pong.data()), pong.size() };
+            if (n == c.owed && !c.last.empty())
+                iov[n++] = { const_cast<char*>(c.last.data()), c.last.size() };
+            iov[0].iov_base = static_cast<char*>(iov[0].iov_base) + c.out_offset;
+            iov[0].iov_len -= c.out_offset;
+
+            ssize_t written = writev(c.fd, iov, static_cast<int>(n));
+            if (written < 0)
+            {
+                if (errno == EINTR) continue;
+                return errno == EAGAIN;      // EPOLLOUT resumes it
+            }
+
+            size_t left = c.out_offset + written;
+            size_t whole = min<size_t>(left / pong.size(), c.owed);
+            c.owed -= whole;
+            left -= whole * pong.size();
+            if (c.owed == 0 && !c.last.empty() && left == c.last.size())
+                return false;                // the final response is out
+            c.out_offset = left;
+        }
+        return c.reading;
+    }
+
+    // false when the connection is finished with
+    bool read_from(Connection& c)
+    {
+        while (c.reading)
+        {
+            ssize_t n = read(c.fd, c.in + c.have, max_request - c.have);
+            if (n == 0)
+            {
+                // a half-closed client still gets the answers to what it sent
+                c.reading = false;
+                return true;
+            }
+            if (n < 0)
+            {
+                if (errno == EINTR) continue;
+                return errno == EAGAIN;
+            }
+            c.have += n;
+            size_t used = parse(c);
+            memmove(c.in, c.in + used, c.have - used);
+            c.have -= used;
+        }
+        return true;
+    }
+
+    void serve(uint16_t port)
+    {
+        int listener = listen_on(port);
+        int epoll_fd = epoll_create1(0);
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.ptr = nullptr;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listener, &ev);
+
+        vector<epoll_event> events(1024);
+        for (;;)
+        {
+            int n = epoll_wait(epoll_fd, events.data(), static_cast<int>(events.size()), -1);
+            if (n < 0 && errno != EINTR) die("epoll_wait");
+            for (int i = 0; i < n; ++i)
+            {
+                auto c = static_cast<Connection*>(events[i].data.ptr);
+                if (!c)
+                {
+                    for (;;)
+                    {
+                        int fd = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK);
+                        if (fd < 0)
+                        {
+                            if (errno == EINTR || errno == ECONNABORTED) continue;
+                            if (errno == EMFILE || errno == ENFILE) cerr << "out of file descriptors\n";
+                            break;
+                        }
+                        int one = 1;
+                        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+                        auto connection = new Connection;
+                        connection->fd = fd;
+                        epoll_event cev{};
+                        cev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+                        cev.data.ptr = connection;
+                        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &cev);
+                    }
+                    continue;
+                }
+
+                bool open = !(events[i].events & EPOLLERR);
+                if (open && (events[i].events & (EPOLLIN | EPOLLRDHUP))) open = read_from(*c);
+                if (open) open = flush(*c);
+                if (!open)
+                {
+                    close(c->fd);            // also takes it out of the epoll set
+                    delete c;
+                }
+            }
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const uint16_t port = argc > 1 ? static_cast<uint16_t>(stoul(argv[1])) : 9149;
+    const size_t threads = argc > 2 ? stoul(argv[2]) : max(thread::hardware_concurrency(), 1u);
+    signal(SIGPIPE, SIG_IGN);
+
+    vector<thread> workers;
+    for (size_t i = 1; i < threads; ++i) workers.emplace_back(serve, port);
+    cout << "Listening for requests on http://localhost:" << port << "/ with " << threads << " threads" << endl;
+    serve(port);
+}
@@ -0,0 +1,282 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <semaphore>
+#include <string>
+#include <vector>
+#include <cpprest/http_client.h>
+#include <cpprest/json.h>
+#include "pingable.hpp"
+using namespace utility;                    // Common utilities like string conversions
+using namespace web;                        // Common features like URIs.
+using namespace web::http;                  // Common HTTP functionality
+using namespace web::http::client;          // HTTP client features
+
+using namespace std;
+
+// messages are plain ASCII: one byte per character, like the answer's
+// conversion back to wstring
+inline utility::string_t narrow(const wstring& s)
+{
+    utility::string_t out;
+    out.reserve(s.size());
+    for (auto c : s) out.push_back(static_cast<char>(c));
+    return out;
+}
+
+// The first version: a new http_client, and so a new connection, per ping.
+// Kept to compare against.
+struct OneShotRemotePong : Pingable
+{
+    utility::string_t server;
+
+    explicit OneShotRemotePong(const utility::string_t& server = U("http://localhost:9149/"))
+        : server(server)
+    {
+    }
+
+    wstring ping(const wstring& message) override
+    {
+        http_client client(server);
+        uri_builder builder(U("/api/pingpong/"));
+        builder.append_query(U("message"), narrow(message));
+
+        return client.request(methods::GET, builder.to_string())
+            .then([](http_response r) {
+                return r.extract_string();
+            })
+            .then([](const utility::string_t& str) {
+                return wstring(str.begin(), str.end());
+            })
+            .get();
+    }
+};
+
+
+// Talks to the pong server over a fixed set of http_clients that live as
+// long as the proxy. Each keeps its keep-alive connections open, so a ping
+// only pays for the request itself.
+//
+// ping_async() doesn't wait for the answer: many pings are on the wire at
+// once, spread round robin over the clients. At most `max_in_flight` are
+// outstanding; past that ping_async() blocks until one completes, which is
+// how the caller controls the load put on the server. Because it blocks,
+// don't call it from a pplx continuation or anything else running on the
+// pplx pool: with every slot taken it holds a pool thread that completions
+// may need.
+class RemotePong : public Pingable
+{
+    vector<unique_ptr<http_client>> clients;
+    atomic<size_t> next{ 0 };
+    ptrdiff_t max_in_flight;
+    // shared with the continuations: the last release() can still be running
+    // when the destructor's acquire() returns
+    shared_ptr<counting_semaphore<>> in_flight;
+
+    // gives a slot back unless disarmed, once its continuation is attached
+    struct SlotGuard
+    {
+        counting_semaphore<>* slots;
+        ~SlotGuard()
+        {
+            if (slots) slots->release();
+        }
+    };
+
+public:
+    explicit RemotePong(const utility::string_t& server = U("http://localhost:9149/"),
+                        size_t connections = 4, ptrdiff_t max_in_flight = 64)
+        : max_in_flight(max<ptrdiff_t>(max_in_flight, 1)), in_flight(make_shared<counting_semaphore<>>(this->max_in_flight))
+    {
+        http_client_config config;
+        config.set_timeout(chrono::seconds(10));
+        for (size_t i = 0; i < max<size_t>(connections, 1); ++i)
+            clients.push_back(make_unique<http_client>(server, config));
+    }
+
+    // waits for the pings still on the wire
+    ~RemotePong()
+    {
+        for (ptrdiff_t i = 0; i < max_in_flight; ++i)
+            in_flight->acquire();
+    }
+
+    pplx::task<wstring> ping_async(const wstring& message) override
+    {
+        in_flight->acquire();
+        SlotGuard slot{ in_flight.get() };      // request() may throw (a bad URI, ...)
+        auto& client = *clients[next.fetch_add(1, memory_order_relaxed) % clients.size()];
+        uri_builder builder(U("/api/pingpong/"));
+        builder.append_query(U("message"), narrow(message));
+
+        auto result = client.request(methods::GET, builder.to_string())
+            .then([](http_response r) {
+                return r.extract_string();
+            })
+            .then([slots = in_flight](pplx::task<utility::string_t> answer) {
+                // a task based continuation runs on failure too, the slot is always returned
+                slots->release();
+                auto str = answer.get();
+                return wstring(str.begin(), str.end());
+            });
+        slot.slots = nullptr;
+        return result;
+    }
+
+    wstring ping(const wstring& message) override
+    {
+        return ping_async(message).get();
+    }
+};
+
+
+// Coalesces pings: while the server is busy with earlier requests, new pings
+// wait here and leave together as one POST /api/pingpong/batch (a JSON array
+// of messages, answered by an array of answers). 10k pings sent at once go
+// out as a few dozen requests instead of 10k round trips.
+//
+// There is no timer: a ping is sent right away when one of the clients is
+// idle, so a lone ping isn't delayed. Batches only form under load, and get
+// bigger the more the server is behind. At most one batch per client is in
+// flight, a batch holds at most `max_batch` pings.
+class BatchingRemotePong : public Pingable
+{
+    struct Waiting
+    {
+        wstring message;
+        pplx::task_completion_event<wstring> answer;
+    };
+
+    vector<unique_ptr<http_client>> clients;
+    size_t max_batch;
+
+    mutex lock;
+    condition_variable idle;
+    vector<Waiting> pending;
+    size_t batches_in_flight = 0;
+    size_t next_client = 0;
+
+    atomic<uint64_t> batches_sent{ 0 }, pings_sent{ 0 };
+
+public:
+    explicit BatchingRemotePong(const utility::string_t& server = U("http://localhost:9149/"),
+                                size_t connections = 4, size_t max_batch = 256)
+        : max_batch(max<size_t>(max_batch, 1))
+    {
+        http_client_config config;
+        config.set_timeout(chrono::seconds(10));
+        for (size_t i = 0; i < max<size_t>(connections, 1); ++i)
+            clients.push_back(make_unique<http_client>(server, config));
+    }
+
+    // waits for every ping to be answered, their continuations use `this`
+    ~BatchingRemotePong()
+    {
+        unique_lock l{ lock };
+        idle.wait(l, [this] { return batches_in_flight == 0 && pending.empty(); });
+    }
+
+    pplx::task<wstring> ping_async(const wstring& message) override
+    {
+        pplx::task_completion_event<wstring> answer;
+        vector<Waiting> batch;
+        size_t client;
+        {
+            lock_guard l{ lock };
+            pending.push_back({ message, answer });
+            if (batches_in_flight == clients.size())
+                return pplx::create_task(answer);    // goes with the next batch
+            client = take_batch(batch);
+        }
+        send(move(batch), client);
+        return pplx::create_task(answer);
+    }
+
+    wstring ping(const wstring& message) override
+    {
+        return ping_async(message).get();
+    }
+
+    double average_batch() const
+    {
+        auto b = batches_sent.load();
+        return b ? double(pings_sent.load()) / b : 0;
+    }
+
+private:
+    // with `lock` held
+    size_t take_batch(vector<Waiting>& batch)
+    {
+        size_t n = min(pending.size(), max_batch);
+        batch.assign(make_move_iterator(pending.begin()), make_move_iterator(pending.begin() + n));
+        pending.erase(pending.begin(), pending.begin() + n);
+        ++batches_in_flight;
+        return next_client++ % clients.size();
+    }
+
+    void send(vector<Waiting> batch, size_t client)
+    {
+        ++batches_sent;
+        pings_sent += batch.size();
+        auto waiting = make_shared<vector<Waiting>>(move(batch));
+        pplx::task<http_response> response;
+        try
+        {
+            auto body = json::value::array(waiting->size());
+            for (size_t i = 0; i < waiting->size(); ++i)
+                body[i] = json::value::string(narrow((*waiting)[i].message));
+            response = clients[client]->request(methods::POST, U("/api/pingpong/batch"), body);
+        }
+        catch (...)
+        {
+            // request() may throw too: the continuation below still fails
+            // every waiter and hands the client on
+            response = pplx::task_from_exception<http_response>(current_exception());
+        }
+        response
+            .then([](http_response r) {
+                return r.extract_json();
+            })
+            .then([this, waiting](pplx::task<json::value> answers) {
+                try
+                {
+                    auto values = answers.get();
+                    auto& list = values.as_array();
+                    for (size_t i = 0; i < waiting->size(); ++i)
+                    {
+                        auto str = list.at(i).as_string();
+                        (*waiting)[i].answer.set(wstring(str.begin(), str.end()));
+                    }
+                }
+                catch (...)
+                {
+                    // answers already set stay, set_exception ignores them
+                    for (auto& w : *waiting)
+                        w.answer.set_exception(current_exception());
+                }
+                finished();
+            });
+    }
+
+    // a batch came back: the client takes whatever queued up meanwhile
+    void finished()
+    {
+        vector<Waiting> batch;
+        size_t client;
+        {
+            lock_guard l{ lock };
+            --batches_in_flight;
+            if (pending.empty())
+            {
+                idle.notify_all();
+                return;
+            }
+            client = take_batch(batch);
+        }
+        send(move(batch), client);
+    }
+};
@@ -1,42 +1,64 @@
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
 #include <string>
 #include <sstream>
 #include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "bitmap.hpp"
+#include "bitmapcache.hpp"
 using namespace std;
 
-struct Image
+struct LazyBitmap : Image
 {
-    virtual ~Image() = default;
-    virtual void draw() = 0;
-};
+    LazyBitmap(const string& filename): filename(filename) {}
 
-struct Bitmap : Image
-{
-    Bitmap(const string& filename)
-    {
-        cout << "Loading image from " << filename << endl;
-    }
+    // drawn from the cache instead, which may have prefetched it
+    LazyBitmap(const string& filename, BitmapCache& cache): filename(filename), cache(&cache) {}
 
     void draw() override
     {
-        cout << "Drawing image" << endl;
+        if (cache)
+        {
+            cache->get(filename)->draw();
+            return;
+        }
+        loaded()->draw();
     }
-};
 
-struct LazyBitmap : Image
-{
-    LazyBitmap(const string& filename): filename(filename) {}
-    ~LazyBitmap() { delete bmp; }
-    void draw() override
+    // the image will be drawn soon
+    void prefetch()
     {
-        if (!bmp)
-        bmp = new Bitmap(filename);
-        bmp->draw();
+        if (cache) cache->prefetch(filename);
     }
 
 private:
-    Bitmap* bmp{nullptr};
+    // Any number of threads can draw at once. Once loaded this is a single
+    // acquire load; until then they line up on the mutex and the first one
+    // loads. The release store publishes a fully built Bitmap.
+    Bitmap* loaded()
+    {
+        if (auto b = bmp.load(memory_order_acquire)) return b;
+        lock_guard l{ loading };
+        if (!owner)
+        {
+            owner = make_unique<Bitmap>(filename);
+            bmp.store(owner.get(), memory_order_release);
+        }
+        return owner.get();
+    }
+
+    atomic<Bitmap*> bmp{nullptr};
+    mutex loading;
+    unique_ptr<Bitmap> owner;       // guarded by `loading`
     string filename;
+    BitmapCache* cache{nullptr};
 };
 
 void draw_image(Image& img)
@@ -46,11 +68,78 @@ void draw_image(Image& img)
     cout << "Done drawing the image" << endl;
 }
 
+void print(BitmapCache& cache)
+{
+    auto s = cache.stats();
+    cout << "cache: " << s.hits << " hits, " << s.waited << " waited, " << s.misses << " misses, "
+         << s.prefetched << " prefetched, " << s.evicted << " evicted, " << s.bitmaps << " bitmaps in "
+         << s.bytes / 1024 << " KB" << endl;
+}
+
+// A fresh directory under the temp dir, so runs at the same time don't share
+// (and delete) each other's images. Removed with everything in it at exit.
+struct TempDir
+{
+    filesystem::path path;
+
+    TempDir()
+    {
+        string name = (filesystem::temp_directory_path() / "virtualproxy-XXXXXX").string();
+        if (!mkdtemp(name.data()))
+            throw filesystem::filesystem_error("mkdtemp", name, error_code(errno, generic_category()));
+        path = name;
+    }
+    ~TempDir()
+    {
+        error_code ignored;
+        filesystem::remove_all(path, ignored);
+    }
+};
+
 int main()
 {
-    LazyBitmap img{ "pokemon.png" };
+    // a few images to load: 256 KB each, in a directory of our own
+    TempDir scratch;
+    auto& dir = scratch.path;
+    vector<string> files;
+    for (int i = 0; i < 6; ++i)
+    {
+        files.push_back((dir / ("pokemon" + to_string(i) + ".png")).string());
+        ofstream{ files.back(), ios::binary } << string(256 << 10, char('a' + i));
+    }
+
+    LazyBitmap img{ files[0] };
     draw_image(img); // loaded whether the bitmap is loaded or not
     draw_image(img);
 
+    // drawn from several threads at once: still loaded once
+    {
+        LazyBitmap shared{ files[1] };
+        vector<thread> drawers;
+        for (int i = 0; i < 4; ++i) drawers.emplace_back([&shared] { shared.draw(); });
+        for (auto& t : drawers) t.join();
+    }
+
+    // Through a cache that holds 3 of them. The next image is prefetched while
+    // the current one is "on screen", so none of the draws waits for a load.
+    {
+        BitmapCache cache{ 768 << 10 };
+        vector<unique_ptr<LazyBitmap>> images;
+        for (auto& f : files) images.push_back(make_unique<LazyBitmap>(f, cache));
+
+        images[0]->prefetch();
+        for (size_t i = 0; i < images.size(); ++i)
+        {
+            if (i + 1 < images.size()) images[i + 1]->prefetch();
+            this_thread::sleep_for(chrono::milliseconds(50));  // a frame
+            images[i]->draw();
+        }
+        print(cache);
+
+        // the first ones were evicted to stay in budget: loaded again, right away
+        images[0]->draw();
+        print(cache);
+    }
+
     return 0;
-}
\ No newline at end of file
+}